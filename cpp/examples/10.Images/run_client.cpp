@@ -0,0 +1,64 @@
+#include "ezcppsocket.h"
+
+// Must match run_server.cpp
+const unsigned int TILES = 4;
+const int DELTA_FRAMES = 5;
+int errors = 0;
+
+void check(bool ok, const std::string &what){
+	std::cout << what << " : " << (ok ? "ok" : "MISMATCH") << "\n";
+	if (!ok)
+		errors++;
+}
+
+bool sameMat(const cv::Mat &a, const cv::Mat &b){
+	if (a.rows != b.rows || a.cols != b.cols || a.type() != b.type())
+		return false;
+	for (int r = 0; r < a.rows; r++)
+		if (memcmp(a.ptr(r), b.ptr(r), a.cols * a.elemSize()) != 0)
+			return false;
+	return true;
+}
+
+// JPEG is lossy, so a JPEG image only has to be close to what was sent
+bool closeMat(const cv::Mat &a, const cv::Mat &b){
+	if (a.rows != b.rows || a.cols != b.cols || a.type() != b.type())
+		return false;
+	return cv::norm(a, b, cv::NORM_L1) / (a.total() * a.channels()) < 8;
+}
+
+// Frame i of the delta images: the image with a square moved along its diagonal
+cv::Mat deltaFrame(const cv::Mat &img, int i){
+	cv::Mat frame = img.clone();
+	frame(cv::Rect(64 * i, 64 * i, 128, 128)).setTo(cv::Scalar(40 * i, 40 * i, 40 * i));
+	return frame;
+}
+
+int main()
+{
+	EzCppSocket c = EzCppSocket("127.0.0.1", 10000, 2, 1, false, true, 1, false, 5);
+	c.setBinaryFraming(true);
+	cv::Mat img = cv::imread("../resources/lena.jpg");
+
+	// Images are split into stripes, encoded and decoded in parallel
+	std::cout << "Tiled JPEG images ...\n";
+	c.setImageTiles(TILES);
+	c.sendImage(img);
+	check(closeMat(c.readImage(), img), "Tiled JPEG");
+
+	std::cout << "Tiled PNG images ...\n";
+	c.setImageCodec(EzCppSocket::CODEC_PNG);
+	c.sendImage(img);
+	check(sameMat(c.readImage(), img), "Tiled PNG");
+
+	// Only the tiles that changed since the last image are sent (threshold 0 keeps them exact)
+	std::cout << "Delta images ...\n";
+	c.setDeltaImages(true, 64, 0.0);
+	for (int i = 0; i < DELTA_FRAMES; i++)
+		c.sendImage(deltaFrame(img, i));
+
+	c.Disconnect();
+
+	std::cout << "Client : " << (errors == 0 ? "passed" : "FAILED") << "\n";
+	return errors == 0 ? 0 : 1;
+}
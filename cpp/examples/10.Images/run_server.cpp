@@ -0,0 +1,63 @@
+#include "ezcppsocket.h"
+
+// Must match run_client.cpp
+const unsigned int TILES = 4;
+const int DELTA_FRAMES = 5;
+int errors = 0;
+
+void check(bool ok, const std::string &what){
+	std::cout << what << " : " << (ok ? "ok" : "MISMATCH") << "\n";
+	if (!ok)
+		errors++;
+}
+
+bool sameMat(const cv::Mat &a, const cv::Mat &b){
+	if (a.rows != b.rows || a.cols != b.cols || a.type() != b.type())
+		return false;
+	for (int r = 0; r < a.rows; r++)
+		if (memcmp(a.ptr(r), b.ptr(r), a.cols * a.elemSize()) != 0)
+			return false;
+	return true;
+}
+
+// JPEG is lossy, so a JPEG image only has to be close to what was sent
+bool closeMat(const cv::Mat &a, const cv::Mat &b){
+	if (a.rows != b.rows || a.cols != b.cols || a.type() != b.type())
+		return false;
+	return cv::norm(a, b, cv::NORM_L1) / (a.total() * a.channels()) < 8;
+}
+
+// Frame i of the delta images: the image with a square moved along its diagonal
+cv::Mat deltaFrame(const cv::Mat &img, int i){
+	cv::Mat frame = img.clone();
+	frame(cv::Rect(64 * i, 64 * i, 128, 128)).setTo(cv::Scalar(40 * i, 40 * i, 40 * i));
+	return frame;
+}
+
+int main()
+{
+	EzCppSocket s = EzCppSocket("127.0.0.1", 10000, 2, 1, false, true, 1, true, 5);
+	s.setBinaryFraming(true);
+	cv::Mat img = cv::imread("../resources/lena.jpg");
+
+	std::cout << "Tiled JPEG images ...\n";
+	s.setImageTiles(TILES);
+	cv::Mat recv_img = s.readImage();
+	check(closeMat(recv_img, img), "Tiled JPEG");
+	s.sendImage(recv_img);
+
+	std::cout << "Tiled PNG images ...\n";
+	s.setImageCodec(EzCppSocket::CODEC_PNG);
+	check(sameMat(s.readImage(), img), "Tiled PNG");
+	s.sendImage(img);
+
+	// Patched together by a Cpp receiver
+	std::cout << "Delta images ...\n";
+	for (int i = 0; i < DELTA_FRAMES; i++)
+		check(sameMat(s.readImage(), deltaFrame(img, i)), "Delta image " + std::to_string(i));
+
+	s.Disconnect();
+
+	std::cout << "Server : " << (errors == 0 ? "passed" : "FAILED") << "\n";
+	return errors == 0 ? 0 : 1;
+}
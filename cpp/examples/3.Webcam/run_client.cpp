@@ -1,7 +1,10 @@
 #include "ezcppsocket.h"
 #include <opencv2/imgproc/imgproc.hpp>
 
+// 0: send a frame and wait for its result (clientLoop)
+// 1: duplex mode, keep FRAMES_IN_FLIGHT frames in flight
 int MODE = 0;
+const unsigned int FRAMES_IN_FLIGHT = 3;
 
 void client_operation(EzCppSocket &c){
     static cv::VideoCapture cap(0);
@@ -39,19 +42,61 @@ void client_operation(EzCppSocket &c){
     }
 }
 
+void duplex_client(EzCppSocket &c){
+    cv::VideoCapture cap(0);
+    if (!cap.isOpened()) {
+        std::cerr << "ERROR: Could not open camera\n";
+        exit(1);
+    }
+    cv::namedWindow("frame", cv::WINDOW_AUTOSIZE);
+
+    c.startDuplex(FRAMES_IN_FLIGHT);
+    while (true)
+    {
+        // Keep the pipeline full, the writer thread encodes and sends
+        if (c.getImagesInFlight() < FRAMES_IN_FLIGHT)
+        {
+            cv::Mat frame; // New Mat per frame, posted frames are not copied
+            cap >> frame;
+            if (!frame.empty())
+            {
+                cv::resize(frame, frame, cv::Size(1920, 1080));
+                c.postImage(frame);
+            }
+        }
+
+        // Show results as they arrive, the reader thread receives and decodes
+        cv::Mat result;
+        if (c.pollImage(result))
+            cv::imshow("frame", result);
+        if (cv::waitKey(1) == 27)
+            break;
+    }
+
+    // Collect the results still in flight so the server sees a clean stop
+    cv::Mat result;
+    while (c.getImagesInFlight() > 0)
+        if (!c.pollImage(result))
+            cv::waitKey(1);
+    c.stopDuplex();
+    cap.release();
+    cv::destroyAllWindows();
+}
+
 int main(int argc, char **argv)
 {
     EzCppSocket c = EzCppSocket("127.0.0.1", 10000, 2, 1, false, true, 1, false, 5, std::pair<std::string, std::string>("start", "end"));
     std::cout << "Press Esc to exit !\n";
 
-    // Set configuration as needed (Increase this value incase end token is
-    // not being read, i.e. give time for packets to be written properly from
-    // server end
-    c.setSleepBetweenPackets(100); 
+    // Set configuration as needed (Optional delay between packets, reads and
+    // writes always transfer complete messages so no delay is required)
+    c.setSleepBetweenPackets(0);
 
     cv::Mat frame, result;
     if (MODE==0)
         c.clientLoop(&client_operation);
+    else if (MODE==1)
+        duplex_client(c);
 
     return 0;
 }
\ No newline at end of file
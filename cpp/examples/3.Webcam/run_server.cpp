@@ -1,6 +1,9 @@
 #include "ezcppsocket.h"
 #include <opencv2/imgproc/imgproc.hpp>
 
+// Must match MODE of run_client.cpp
+// 0: client waits for each result (clientLoop)
+// 1: client uses duplex mode without clientLoop, serve until it disconnects
 int MODE = 0;
 
 void server_operation(EzCppSocket &s){
@@ -26,6 +29,17 @@ int main()
     EzCppSocket s = EzCppSocket("127.0.0.1", 10000, 2, 1, false, true, 1, true, 5, std::pair<std::string, std::string>("start", "end"));
     if (MODE == 0)
         s.serverLoop(&server_operation);
+    else if (MODE == 1)
+    {
+        try
+        {
+            s.serverLoop(&server_operation, -1);
+        }
+        catch (const std::runtime_error &e)
+        {
+            std::cout << "Client disconnected\n";
+        }
+    }
 
     return 0;
 }
\ No newline at end of file
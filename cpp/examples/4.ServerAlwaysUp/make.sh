@@ -1,3 +1,10 @@
 #!/bin/bash
-g++ -I ../../ezcppsocket ../../ezcppsocket/ezcppsocket.cpp run_server.cpp -o run_server `pkg-config --cflags --libs opencv4`
-g++ -I ../../ezcppsocket ../../ezcppsocket/ezcppsocket.cpp run_client.cpp -o run_client `pkg-config --cflags --libs opencv4`
\ No newline at end of file
+# Optional features, e.g. EZCPPSOCKET_LZ4=1 EZCPPSOCKET_ZSTD=1 EZCPPSOCKET_CXX20=1 ./make.sh
+# (LZ4/zstd compression, C++20 for the async API)
+DEFINES=""
+LIBS=""
+if [ "$EZCPPSOCKET_LZ4" = "1" ]; then DEFINES="$DEFINES -DEZCPPSOCKET_WITH_LZ4"; LIBS="$LIBS -llz4"; fi
+if [ "$EZCPPSOCKET_ZSTD" = "1" ]; then DEFINES="$DEFINES -DEZCPPSOCKET_WITH_ZSTD"; LIBS="$LIBS -lzstd"; fi
+if [ "$EZCPPSOCKET_CXX20" = "1" ]; then DEFINES="$DEFINES -std=c++20"; fi
+g++ $DEFINES -pthread -I ../../ezcppsocket ../../ezcppsocket/ezcppsocket.cpp run_server.cpp -o run_server `pkg-config --cflags --libs opencv4` $LIBS -lrt
+g++ $DEFINES -pthread -I ../../ezcppsocket ../../ezcppsocket/ezcppsocket.cpp run_client.cpp -o run_client `pkg-config --cflags --libs opencv4` $LIBS -lrt
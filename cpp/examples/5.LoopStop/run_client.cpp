@@ -0,0 +1,43 @@
+#include "ezcppsocket.h"
+
+// Must match ITERATIONS of run_server.cpp
+const int ITERATIONS = 10;
+int iteration = 0;
+int errors = 0;
+
+// Default loop (status string sent after every iteration), the server sends first
+void server_sends_first(EzCppSocket &c){
+	int value = c.readInt();
+	if (value != iteration)
+		errors++;
+	c.sendInt(2 * value);
+	if (++iteration == ITERATIONS)
+		c.stopLoop();
+}
+
+// setLoopStopMessage(true), the client has to send first in every iteration
+void client_sends_first(EzCppSocket &c){
+	c.sendInt(iteration);
+	if (c.readInt() != iteration + 1)
+		errors++;
+	if (++iteration == ITERATIONS)
+		c.stopLoop();
+}
+
+int main()
+{
+	EzCppSocket c = EzCppSocket("127.0.0.1", 10000, 2, 1, false, true, 1, false, 5);
+
+	std::cout << "Server sends first ...\n";
+	c.clientLoop(&server_sends_first, 0, false);
+
+	std::cout << "Client sends first, loop ends with a stop message ...\n";
+	c.setLoopStopMessage(true);
+	iteration = 0;
+	c.clientLoop(&client_sends_first, 0, false);
+
+	c.Disconnect();
+
+	std::cout << "Client : " << (errors == 0 ? "passed" : "FAILED") << "\n";
+	return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,42 @@
+#include "ezcppsocket.h"
+
+// Must match ITERATIONS of run_client.cpp
+const int ITERATIONS = 10;
+int iteration = 0;
+int errors = 0;
+
+// Default loop (status string read after every iteration), the server sends first
+void server_sends_first(EzCppSocket &s){
+	s.sendInt(iteration);
+	if (s.readInt() != 2 * iteration)
+		errors++;
+	iteration++;
+}
+
+// setLoopStopMessage(true), the client has to send first in every iteration
+void client_sends_first(EzCppSocket &s){
+	s.sendInt(s.readInt() + 1);
+	iteration++;
+}
+
+int main()
+{
+	EzCppSocket s = EzCppSocket("127.0.0.1", 10000, 2, 1, false, true, 1, true, 5);
+
+	std::cout << "Server sends first ...\n";
+	s.serverLoop(&server_sends_first, 0, false);
+	if (iteration != ITERATIONS)
+		errors++;
+
+	std::cout << "Client sends first, loop ends with a stop message ...\n";
+	s.setLoopStopMessage(true);
+	iteration = 0;
+	s.serverLoop(&client_sends_first, 0, false);
+	if (iteration != ITERATIONS)
+		errors++;
+
+	s.Disconnect();
+
+	std::cout << "Server : " << (errors == 0 ? "passed" : "FAILED") << "\n";
+	return errors == 0 ? 0 : 1;
+}
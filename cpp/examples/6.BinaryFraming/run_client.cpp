@@ -0,0 +1,74 @@
+#include "ezcppsocket.h"
+
+// Sent both ways with binary framing and binary lists, must match run_server.cpp
+const std::string STRING = "Binary framing round trip";
+const int INT = -123456;
+const float FLOAT = 3.25f;
+int errors = 0;
+
+void check(bool ok, const std::string &what){
+	std::cout << what << " : " << (ok ? "ok" : "MISMATCH") << "\n";
+	if (!ok)
+		errors++;
+}
+
+bool sameMat(const cv::Mat &a, const cv::Mat &b){
+	if (a.rows != b.rows || a.cols != b.cols || a.type() != b.type())
+		return false;
+	for (int r = 0; r < a.rows; r++)
+		if (memcmp(a.ptr(r), b.ptr(r), a.cols * a.elemSize()) != 0)
+			return false;
+	return true;
+}
+
+int main()
+{
+	EzCppSocket c = EzCppSocket("127.0.0.1", 10000, 2, 1, false, true, 1, false, 5);
+	c.setBinaryFraming(true);
+	c.setBinaryLists(true);
+
+	std::vector<int> int_list;
+	for (int i = 0; i < 100; i++)
+		int_list.push_back(3 * i - 7);
+	std::vector<float> float_list;
+	for (int i = 0; i < 40; i++)
+		float_list.push_back(0.25f * i);
+	std::vector<float> float_tensor(2 * 3 * 4);
+	for (size_t i = 0; i < float_tensor.size(); i++)
+		float_tensor[i] = 0.5f * i;
+	std::vector<int16_t> int16_tensor(3 * 5);
+	for (size_t i = 0; i < int16_tensor.size(); i++)
+		int16_tensor[i] = 1000 - 150 * int(i);
+	cv::Mat mat(4, 5, CV_8UC3);
+	for (size_t i = 0; i < mat.total() * mat.elemSize(); i++)
+		mat.data[i] = i;
+
+	// Sending
+	std::cout << "Sending data...\n";
+	c.sendString(STRING);
+	c.sendInt(INT);
+	c.sendFloat(FLOAT);
+	c.sendIntList(int_list);
+	c.sendFloatList(float_list);
+	c.sendTensor(float_tensor.data(), {2, 3, 4});
+	c.sendTensor(int16_tensor.data(), {3, 5});
+	c.sendMat(mat);
+
+	// Receiving
+	std::cout << "Receiving data...\n";
+	check(c.readString() == STRING, "String");
+	check(c.readInt() == INT, "Int");
+	check(c.readFloat() == FLOAT, "Float");
+	check(c.readIntList() == int_list, "Int List");
+	check(c.readFloatList() == float_list, "Float List");
+	EzTensor<float> t1 = c.readTensor<float>();
+	check(t1.shape == std::vector<size_t>({2, 3, 4}) && t1.data == float_tensor, "Float Tensor");
+	EzTensor<int16_t> t2 = c.readTensor<int16_t>();
+	check(t2.shape == std::vector<size_t>({3, 5}) && t2.data == int16_tensor, "Int16 Tensor");
+	check(sameMat(c.readMat(), mat), "Mat");
+
+	c.Disconnect();
+
+	std::cout << "Client : " << (errors == 0 ? "passed" : "FAILED") << "\n";
+	return errors == 0 ? 0 : 1;
+}
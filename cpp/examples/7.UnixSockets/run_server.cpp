@@ -0,0 +1,57 @@
+#include "ezcppsocket.h"
+
+// Echoed back over a stream socket and a seqpacket socket, must match run_client.cpp
+const std::string STREAM_PATH = "/tmp/ezsocket_example.sock";
+const std::string SEQPACKET_PATH = "@ezsocket_example"; // Abstract namespace, no file is created
+const std::string STRING = "Unix domain socket round trip";
+int errors = 0;
+
+void check(bool ok, const std::string &what){
+	std::cout << what << " : " << (ok ? "ok" : "MISMATCH") << "\n";
+	if (!ok)
+		errors++;
+}
+
+bool sameMat(const cv::Mat &a, const cv::Mat &b){
+	if (a.rows != b.rows || a.cols != b.cols || a.type() != b.type())
+		return false;
+	for (int r = 0; r < a.rows; r++)
+		if (memcmp(a.ptr(r), b.ptr(r), a.cols * a.elemSize()) != 0)
+			return false;
+	return true;
+}
+
+void serve(int socket_type, const std::string &path){
+	EzCppSocket s = EzCppSocket(path, 0, AF_UNIX, socket_type, false, true, 1, true, 5);
+
+	std::vector<int> int_list;
+	for (int i = 0; i < 1000; i++)
+		int_list.push_back(i * i);
+	// Larger than a seqpacket record, so it is carried in several records
+	cv::Mat mat(480, 640, CV_8UC3);
+	for (size_t i = 0; i < mat.total() * mat.elemSize(); i++)
+		mat.data[i] = i % 251;
+
+	std::cout << "Receiving data...\n";
+	check(s.readString() == STRING, "String");
+	check(s.readIntList() == int_list, "Int List");
+	check(sameMat(s.readMat(), mat), "Mat");
+
+	std::cout << "Sending data...\n";
+	s.sendString(STRING);
+	s.sendIntList(int_list);
+	s.sendMat(mat);
+
+	s.Disconnect();
+}
+
+int main()
+{
+	std::cout << "SOCK_STREAM at " << STREAM_PATH << " ...\n";
+	serve(SOCK_STREAM, STREAM_PATH);
+	std::cout << "SOCK_SEQPACKET at " << SEQPACKET_PATH << " ...\n";
+	serve(SOCK_SEQPACKET, SEQPACKET_PATH);
+
+	std::cout << "Server : " << (errors == 0 ? "passed" : "FAILED") << "\n";
+	return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,51 @@
+#include "ezcppsocket.h"
+
+// Echoed back over UDP, must match run_server.cpp
+const std::string STRING = "UDP round trip";
+int errors = 0;
+
+void check(bool ok, const std::string &what){
+	std::cout << what << " : " << (ok ? "ok" : "MISMATCH") << "\n";
+	if (!ok)
+		errors++;
+}
+
+bool sameMat(const cv::Mat &a, const cv::Mat &b){
+	if (a.rows != b.rows || a.cols != b.cols || a.type() != b.type())
+		return false;
+	for (int r = 0; r < a.rows; r++)
+		if (memcmp(a.ptr(r), b.ptr(r), a.cols * a.elemSize()) != 0)
+			return false;
+	return true;
+}
+
+int main()
+{
+	// UDP has no connection to wait for, the server has to be up before the client sends
+	EzCppSocket c = EzCppSocket("127.0.0.1", 10000, AF_INET, SOCK_DGRAM, false, true, 1, false, 1);
+	// A lost datagram fails the test instead of blocking it
+	c.setDatagramTimeout(5000);
+
+	// Split into about 40 datagrams of the default 1400 bytes
+	cv::Mat mat(120, 160, CV_8UC3);
+	for (size_t i = 0; i < mat.total() * mat.elemSize(); i++)
+		mat.data[i] = i % 251;
+	cv::Mat img = cv::imread("../resources/lena.jpg");
+
+	std::cout << "Sending data...\n";
+	c.sendString(STRING);
+	c.sendMat(mat);
+	c.sendImage(img);
+
+	std::cout << "Receiving data...\n";
+	check(c.readString() == STRING, "String");
+	check(sameMat(c.readMat(), mat), "Mat");
+	cv::Mat recv_img = c.readImage();
+	check(recv_img.size() == img.size() && recv_img.type() == img.type(), "Image");
+
+	std::cout << "Dropped frames : " << c.getDroppedFrames() << "\n";
+	c.Disconnect();
+
+	std::cout << "Client : " << (errors == 0 ? "passed" : "FAILED") << "\n";
+	return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,49 @@
+#include "ezcppsocket.h"
+
+// Echoed back over UDP, must match run_client.cpp
+const std::string STRING = "UDP round trip";
+int errors = 0;
+
+void check(bool ok, const std::string &what){
+	std::cout << what << " : " << (ok ? "ok" : "MISMATCH") << "\n";
+	if (!ok)
+		errors++;
+}
+
+bool sameMat(const cv::Mat &a, const cv::Mat &b){
+	if (a.rows != b.rows || a.cols != b.cols || a.type() != b.type())
+		return false;
+	for (int r = 0; r < a.rows; r++)
+		if (memcmp(a.ptr(r), b.ptr(r), a.cols * a.elemSize()) != 0)
+			return false;
+	return true;
+}
+
+int main()
+{
+	// Returns once the first datagram of the client has arrived
+	EzCppSocket s = EzCppSocket("127.0.0.1", 10000, AF_INET, SOCK_DGRAM, false, true, 1, true, 5);
+
+	// Split into about 40 datagrams of the default 1400 bytes
+	cv::Mat mat(120, 160, CV_8UC3);
+	for (size_t i = 0; i < mat.total() * mat.elemSize(); i++)
+		mat.data[i] = i % 251;
+	cv::Mat img = cv::imread("../resources/lena.jpg");
+
+	std::cout << "Receiving data...\n";
+	check(s.readString() == STRING, "String");
+	check(sameMat(s.readMat(), mat), "Mat");
+	cv::Mat recv_img = s.readImage();
+	check(recv_img.size() == img.size() && recv_img.type() == img.type(), "Image");
+
+	std::cout << "Sending data...\n";
+	s.sendString(STRING);
+	s.sendMat(mat);
+	s.sendImage(recv_img);
+
+	std::cout << "Dropped frames : " << s.getDroppedFrames() << "\n";
+	s.Disconnect();
+
+	std::cout << "Server : " << (errors == 0 ? "passed" : "FAILED") << "\n";
+	return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,63 @@
+#include "ezcppsocket.h"
+
+// Echoed back with LZ4 and then zstd compression, must match run_server.cpp
+// Build with EZCPPSOCKET_LZ4=1 EZCPPSOCKET_ZSTD=1 ./make.sh
+const std::string SHORT_STRING = "Below the compression threshold";
+int errors = 0;
+
+void check(bool ok, const std::string &what){
+	std::cout << what << " : " << (ok ? "ok" : "MISMATCH") << "\n";
+	if (!ok)
+		errors++;
+}
+
+bool sameMat(const cv::Mat &a, const cv::Mat &b){
+	if (a.rows != b.rows || a.cols != b.cols || a.type() != b.type())
+		return false;
+	for (int r = 0; r < a.rows; r++)
+		if (memcmp(a.ptr(r), b.ptr(r), a.cols * a.elemSize()) != 0)
+			return false;
+	return true;
+}
+
+int main()
+{
+	EzCppSocket c = EzCppSocket("127.0.0.1", 10000, 2, 1, false, true, 1, false, 5);
+	c.setBinaryFraming(true);
+	c.setBinaryLists(true);
+
+	std::string long_string;
+	for (int i = 0; i < 2000; i++)
+		long_string += "Compressible line " + std::to_string(i % 10) + "\n";
+	std::vector<float> float_list;
+	for (int i = 0; i < 10000; i++)
+		float_list.push_back(0.5f * (i % 16));
+	cv::Mat mat(240, 320, CV_8UC3);
+	for (int r = 0; r < mat.rows; r++)
+		for (size_t i = 0; i < mat.cols * mat.elemSize(); i++)
+			mat.ptr(r)[i] = r;
+
+	for (auto method : {EzCppSocket::COMPRESSION_LZ4, EzCppSocket::COMPRESSION_ZSTD})
+	{
+		std::cout << (method == EzCppSocket::COMPRESSION_LZ4 ? "LZ4" : "zstd") << " ...\n";
+		c.setCompression(method);
+		check(c.getCompression() == method, "Compression available");
+
+		std::cout << "Sending data...\n";
+		c.sendString(long_string);
+		c.sendString(SHORT_STRING);
+		c.sendFloatList(float_list);
+		c.sendMat(mat);
+
+		std::cout << "Receiving data...\n";
+		check(c.readString() == long_string, "Long String");
+		check(c.readString() == SHORT_STRING, "Short String");
+		check(c.readFloatList() == float_list, "Float List");
+		check(sameMat(c.readMat(), mat), "Mat");
+	}
+
+	c.Disconnect();
+
+	std::cout << "Client : " << (errors == 0 ? "passed" : "FAILED") << "\n";
+	return errors == 0 ? 0 : 1;
+}
@@ -1,5 +1,12 @@
 #!/bin/bash
 VERSION=".0.0.3"
-gcc -shared -fPIC -o libezcppsocket.so${VERSION} -I/usr/local/include/opencv4 ezcppsocket.cpp
+# Optional features, e.g. EZCPPSOCKET_LZ4=1 EZCPPSOCKET_ZSTD=1 EZCPPSOCKET_CXX20=1 ./create_shared_lib.sh
+# (LZ4/zstd compression, C++20 for the async API)
+DEFINES=""
+LIBS=""
+if [ "$EZCPPSOCKET_LZ4" = "1" ]; then DEFINES="$DEFINES -DEZCPPSOCKET_WITH_LZ4"; LIBS="$LIBS -llz4"; fi
+if [ "$EZCPPSOCKET_ZSTD" = "1" ]; then DEFINES="$DEFINES -DEZCPPSOCKET_WITH_ZSTD"; LIBS="$LIBS -lzstd"; fi
+if [ "$EZCPPSOCKET_CXX20" = "1" ]; then DEFINES="$DEFINES -std=c++20"; fi
+gcc -shared -fPIC -pthread -o libezcppsocket.so${VERSION} $DEFINES -I/usr/local/include/opencv4 ezcppsocket.cpp $LIBS -lrt
 # ln -s libezcppsocket.so${VERSION} libezcppsocket.so
 # cp libezcppsocket.so /usr/local/lib/libezcppsocket.so # To give it access across the system
\ No newline at end of file
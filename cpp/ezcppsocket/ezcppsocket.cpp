@@ -1,5 +1,8 @@
 #include "ezcppsocket.h"
 
+// Sent in place of the 16 digit size header to stop the server loop (text framing)
+static const char loop_stop_marker[] = "EZSOCKETLOOPSTOP";
+
 /**
  * @brief Construct a new Py C Client object
  * 
@@ -33,13 +36,9 @@ EzCppSocket::EzCppSocket(std::string server_address,
 	this->debug = debug;
 	this->reconnect_on_address_busy = reconnect_on_address_busy;
 	this->tokens = tokens;
+	this->client_connection_count = client_connection_count;
 
-	this->serv_addr.sin_family = this->socket_family;
-	this->serv_addr.sin_port = htons(this->server_port);
-
-	// Convert IPv4 and IPv6 addresses from text to binary form
-	if (inet_pton(this->socket_family, this->server_address.c_str(), &this->serv_addr.sin_addr) <= 0)
-		printf("\nInvalid address/ Address not supported \n");
+	this->buildAddress();
 
 	if (auto_connect)
 	{
@@ -47,11 +46,15 @@ EzCppSocket::EzCppSocket(std::string server_address,
 		printf((server_mode ? "Server" : "Client"));
 		printf("...\n");
 
-		printf("Starting up on %s port %s\n", this->server_address.c_str(), std::to_string(this->server_port).c_str());
+		if (this->socket_family == AF_UNIX)
+			printf("Starting up on %s\n", this->server_address.c_str());
+		else
+			printf("Starting up on %s port %s\n", this->server_address.c_str(), std::to_string(this->server_port).c_str());
 		if (server_mode)
 		{
 			int opt = 1;
-			int addrlen = sizeof(this->serv_addr);
+			struct sockaddr_storage client_addr;
+			socklen_t addrlen = sizeof(client_addr);
 
 			// Creating socket file descriptor
 			if ((this->fd = socket(this->socket_family, this->socket_type, 0)) == 0)
@@ -62,21 +65,28 @@ EzCppSocket::EzCppSocket(std::string server_address,
 			else
 				printf("Socket creation successful\n");
 
+			if (this->socket_family == AF_UNIX)
+				this->removeStaleSocketFile();
 			// Forcefully attaching socket to the port
-			if (setsockopt(this->fd, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT,
-						   &opt, sizeof(opt)))
+			else if (setsockopt(this->fd, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT,
+								&opt, sizeof(opt)))
 			{
 				perror("Setsockopt failed");
 				exit(EXIT_FAILURE);
 			}
-			this->serv_addr.sin_addr.s_addr = INADDR_ANY;
+
+			// Servers listen on all interfaces
+			if (this->socket_family == AF_INET)
+				((struct sockaddr_in *)&this->serv_addr)->sin_addr.s_addr = INADDR_ANY;
+			else if (this->socket_family == AF_INET6)
+				((struct sockaddr_in6 *)&this->serv_addr)->sin6_addr = in6addr_any;
 
 			bool address_free_flag = false;
 			while (!address_free_flag)
 			{
 				// Forcefully attaching socket to the specified port
 				if (bind(this->fd, (struct sockaddr *)&this->serv_addr,
-						 sizeof(this->serv_addr)) < 0)
+						 this->serv_addr_len) < 0)
 				{
 					printf("\nServer Binding to Address Failed...\n");
 					if (this->reconnect_on_address_busy == 0)
@@ -90,21 +100,39 @@ EzCppSocket::EzCppSocket(std::string server_address,
 					address_free_flag = true;
 			}
 
-			if (listen(this->fd, 1) < 0) // queue of pending connections -> 1
+			if (this->socket_type == SOCK_DGRAM)
+			{
+				// UDP has no connections, the bound socket talks to the first client heard from
+				this->sock = this->fd;
+				this->fd = -1;
+				if (this->client_connection_count > 1)
+					printf("UDP servers serve a single client\n");
+				this->client_connection_count = 1;
+				this->configureDatagramSocket();
+				this->waitForDatagramPeer();
+				return;
+			}
+
+			if (listen(this->fd, std::max(this->client_connection_count, 1)) < 0) // queue of pending connections
 			{
 				perror("listen");
 				exit(EXIT_FAILURE);
 			}
 
+			if (this->client_connection_count > 1)
+			{
+				// Connections are accepted and served by serverLoop
+				printf("Waiting for up to %d connections ...\n", this->client_connection_count);
+				return;
+			}
+
 			printf("Waiting for a connection ...\n");
-			if ((this->sock = accept(this->fd, (struct sockaddr *)&this->serv_addr,
-							   (socklen_t *)&addrlen)) < 0)
+			if ((this->sock = accept(this->fd, (struct sockaddr *)&client_addr, &addrlen)) < 0)
 			{
 				perror("accept");
 				exit(EXIT_FAILURE);
 			}
-			if (this->socket_family == AF_INET) // TODO: Check for IPV6 as well
-				printf("Connected IP address: %s:%d\n", inet_ntoa(this->serv_addr.sin_addr), htons(this->serv_addr.sin_port));
+			this->printPeerAddress(client_addr);
 			printf("Connection established ...\n");
 		}
 		else
@@ -113,18 +141,155 @@ EzCppSocket::EzCppSocket(std::string server_address,
 				printf("Socket creation error\n");
 			else
 				printf("Socket creation successful\n");
+			if (this->socket_type == SOCK_DGRAM)
+				this->configureDatagramSocket();
 			this->establishConnect();
 		}
 	}
 }
+/**
+ * @brief Construct the object for a connection accepted by a multi-client
+ * server. It takes over the settings of the server and owns connection_sock.
+ * 
+ * @param server Server that accepted the connection
+ * @param connection_sock Socket of the accepted connection
+ */
+EzCppSocket::EzCppSocket(const EzCppSocket &server, int connection_sock)
+{
+	this->sock = connection_sock;
+	this->server_address = server.server_address;
+	this->server_port = server.server_port;
+	this->socket_family = server.socket_family;
+	this->socket_type = server.socket_type;
+	this->debug = server.debug;
+	this->serv_addr = server.serv_addr;
+	this->serv_addr_len = server.serv_addr_len;
+	this->client_connection_count = 1;
+	this->reconnect_on_address_busy = server.reconnect_on_address_busy;
+	this->tokens = server.tokens;
+	this->sleep_between_packets = server.sleep_between_packets;
+	this->packet_size = server.packet_size;
+	this->rate_limit = server.rate_limit;
+	this->rate_burst = server.rate_burst;
+	this->rate_tokens = server.rate_burst;
+	this->rate_refill_time = std::chrono::steady_clock::now();
+	this->binary_framing = server.binary_framing;
+	this->binary_lists = server.binary_lists;
+	this->loop_stop_message = server.loop_stop_message;
+	this->max_message_size = server.max_message_size;
+	this->image_codec = server.image_codec;
+	this->image_quality = server.image_quality;
+	this->keep_channels = server.keep_channels;
+	this->image_tiles = server.image_tiles;
+	this->tile_threads = server.tile_threads;
+	this->streaming_images = server.streaming_images;
+	this->delta_images = server.delta_images;
+	this->delta_tile_size = server.delta_tile_size;
+	this->delta_threshold = server.delta_threshold;
+	this->keyframe_interval = server.keyframe_interval;
+	this->tile_callback = server.tile_callback;
+	this->compression = server.compression;
+	this->compression_level = server.compression_level;
+	this->compression_threshold = server.compression_threshold;
+}
+
 /**
  * @brief Destroy the Py C Client object
  * 
  */
 EzCppSocket::~EzCppSocket(){
+	this->stopPublisher();
+	this->stopDuplex();
 	this->Disconnect();
 };
 
+/**
+ * @brief Fill serv_addr from server_address and server_port.
+ * For AF_UNIX, server_address is the socket path (the port is not used) and a
+ * leading '@' selects the Linux abstract namespace instead of a file.
+ */
+void EzCppSocket::buildAddress()
+{
+	memset(&this->serv_addr, 0, sizeof(this->serv_addr));
+	if (this->socket_family == AF_UNIX)
+	{
+		struct sockaddr_un *addr = (struct sockaddr_un *)&this->serv_addr;
+		addr->sun_family = AF_UNIX;
+		if (this->server_address.length() >= sizeof(addr->sun_path))
+			printf("\nUnix socket path is too long (at most %zu characters) \n", sizeof(addr->sun_path) - 1);
+
+		const size_t path_length = std::min(this->server_address.length(), sizeof(addr->sun_path) - 1);
+		memcpy(addr->sun_path, this->server_address.data(), path_length);
+		const bool abstract = path_length > 0 && addr->sun_path[0] == '@';
+		if (abstract)
+			addr->sun_path[0] = '\0';
+		// Abstract names are not null terminated
+		this->serv_addr_len = offsetof(struct sockaddr_un, sun_path) + path_length + (abstract ? 0 : 1);
+	}
+	else if (this->socket_family == AF_INET6)
+	{
+		struct sockaddr_in6 *addr = (struct sockaddr_in6 *)&this->serv_addr;
+		addr->sin6_family = AF_INET6;
+		addr->sin6_port = htons(this->server_port);
+		if (inet_pton(AF_INET6, this->server_address.c_str(), &addr->sin6_addr) <= 0)
+			printf("\nInvalid address/ Address not supported \n");
+		this->serv_addr_len = sizeof(struct sockaddr_in6);
+	}
+	else
+	{
+		struct sockaddr_in *addr = (struct sockaddr_in *)&this->serv_addr;
+		addr->sin_family = this->socket_family;
+		addr->sin_port = htons(this->server_port);
+		if (inet_pton(this->socket_family, this->server_address.c_str(), &addr->sin_addr) <= 0)
+			printf("\nInvalid address/ Address not supported \n");
+		this->serv_addr_len = sizeof(struct sockaddr_in);
+	}
+}
+
+/**
+ * @brief Remove the socket file left behind by a Unix domain server that is no
+ * longer running, so bind can reuse the path. A file that still accepts
+ * connections is left alone and bind reports the address as busy.
+ */
+void EzCppSocket::removeStaleSocketFile()
+{
+	struct stat file_stat;
+	if (this->server_address.empty() || this->server_address[0] == '@' ||
+		stat(this->server_address.c_str(), &file_stat) != 0 || !S_ISSOCK(file_stat.st_mode))
+		return;
+
+	int probe = socket(AF_UNIX, this->socket_type, 0);
+	if (probe < 0)
+		return;
+	if (connect(probe, (struct sockaddr *)&this->serv_addr, this->serv_addr_len) < 0 && errno == ECONNREFUSED)
+	{
+		printf("Removing stale socket file %s\n", this->server_address.c_str());
+		unlink(this->server_address.c_str());
+	}
+	close(probe);
+}
+
+/**
+ * @brief Print the address of an accepted peer
+ * @param peer_addr Address returned by accept
+ */
+void EzCppSocket::printPeerAddress(const struct sockaddr_storage &peer_addr)
+{
+	char address[INET6_ADDRSTRLEN] = {0};
+	if (peer_addr.ss_family == AF_INET)
+	{
+		const struct sockaddr_in *addr = (const struct sockaddr_in *)&peer_addr;
+		inet_ntop(AF_INET, &addr->sin_addr, address, sizeof(address));
+		printf("Connected IP address: %s:%d\n", address, ntohs(addr->sin_port));
+	}
+	else if (peer_addr.ss_family == AF_INET6)
+	{
+		const struct sockaddr_in6 *addr = (const struct sockaddr_in6 *)&peer_addr;
+		inet_ntop(AF_INET6, &addr->sin6_addr, address, sizeof(address));
+		printf("Connected IP address: [%s]:%d\n", address, ntohs(addr->sin6_port));
+	}
+}
+
 /**
  * @brief Connect to the socket explicitly
  * Useful if you want to connect at a point much after
@@ -136,7 +301,7 @@ void EzCppSocket::establishConnect()
 	while (!address_free_flag)
 	{
 		std::cout << "Client is waiting to connect to server...\n";
-		if (connect(this->sock, (struct sockaddr *)&this->serv_addr, sizeof(this->serv_addr)) < 0)
+		if (connect(this->sock, (struct sockaddr *)&this->serv_addr, this->serv_addr_len) < 0)
 		{
 			perror("\nClient Connection to Server Failed \n");
 			this->pollingTimeout();
@@ -175,15 +340,30 @@ void EzCppSocket::pollingTimeout()
  */
 void EzCppSocket::Disconnect()
 {
-	close(this->fd);
-	shutdown(this->sock, SHUT_RDWR);
-	close(this->sock);
+	if (this->fd >= 0)
+	{
+		close(this->fd);
+		// Remove the socket file of a Unix domain server
+		if (this->socket_family == AF_UNIX && !this->server_address.empty() && this->server_address[0] != '@')
+			unlink(this->server_address.c_str());
+	}
+	if (this->sock >= 0)
+	{
+		shutdown(this->sock, SHUT_RDWR);
+		close(this->sock);
+	}
+	this->fd = -1;
+	this->sock = -1;
+
+	this->releaseSharedSlot();
+	unmapSharedMemory(this->shm_inbound);
+	unmapSharedMemory(this->shm_outbound);
 }
 
 /**
- * @brief A setter function to add a delay between packet read/write
- * which ensures that it does so properly. It's been observed that 
- * increasing this when images don't come through properly helps.
+ * @brief A setter function to add a delay between packet read/write.
+ * Reads and writes always transfer the complete message, so this is
+ * no longer needed for correctness and defaults to 0 (no delay).
  * @param microseconds 
  */
 void EzCppSocket::setSleepBetweenPackets(unsigned int microseconds)
@@ -202,6 +382,50 @@ unsigned int EzCppSocket::getSleepBetweenPackets()
 	return this->sleep_between_packets;
 }
 
+/**
+ * @brief A setter function to cap the rate of outgoing data with a token
+ * bucket. Every send is limited to burst_size bytes and is followed by a sleep
+ * that keeps the average at bytes_per_second, so the link stays shared
+ * predictably whatever the frame size. Applies to each connection on its own
+ * (the async API is not paced).
+ * @param bytes_per_second Average outgoing rate (0 removes the limit)
+ * @param burst_size Bytes that may be sent at once (0 uses 50 ms worth of data)
+ */
+void EzCppSocket::setRateLimit(size_t bytes_per_second, size_t burst_size)
+{
+	this->rate_limit = bytes_per_second;
+	this->rate_burst = burst_size > 0 ? burst_size : std::max<size_t>(bytes_per_second / 20, 1);
+	this->rate_tokens = this->rate_burst;
+	this->rate_refill_time = std::chrono::steady_clock::now();
+}
+
+/**
+ * @brief A getter function for the outgoing rate limit
+ * @return size_t Bytes per second (0 if unlimited)
+ */
+size_t EzCppSocket::getRateLimit()
+{
+	return this->rate_limit;
+}
+
+/**
+ * @brief Take bytes that were just sent out of the token bucket (see
+ * setRateLimit). If the bucket runs dry, sleep until it is paid back.
+ * @param bytes Number of bytes sent
+ */
+void EzCppSocket::paceSend(size_t bytes)
+{
+	if (this->rate_limit == 0)
+		return;
+
+	const auto now = std::chrono::steady_clock::now();
+	const double elapsed = std::chrono::duration<double>(now - this->rate_refill_time).count();
+	this->rate_refill_time = now;
+	this->rate_tokens = std::min<double>(this->rate_burst, this->rate_tokens + elapsed * this->rate_limit) - bytes;
+	if (this->rate_tokens < 0)
+		std::this_thread::sleep_for(std::chrono::duration<double>(-this->rate_tokens / this->rate_limit));
+}
+
 /**
  * @brief A setter function to set size of packets during read/write
  * Note: The value passed should not be more than 65535 (64K)
@@ -216,6 +440,82 @@ void EzCppSocket::setPacketSize(unsigned int number_of_bytes)
 	
 }
 
+/**
+ * @brief A setter function to switch between binary frame headers and the
+ * 16 digit ASCII size headers. Binary framing sends a fixed width little-endian
+ * header (payload size, message type, flags) in place of the size string.
+ * Note: Both ends of the connection must use the same setting.
+ * @param enable True to use binary frame headers
+ */
+void EzCppSocket::setBinaryFraming(bool enable)
+{
+	this->binary_framing = enable;
+}
+
+/**
+ * @brief A getter function to check if binary frame headers are in use
+ * 
+ * @return true Binary frame headers are used
+ * @return false 16 digit ASCII size headers are used
+ */
+bool EzCppSocket::getBinaryFraming()
+{
+	return this->binary_framing;
+}
+
+/**
+ * @brief A setter function to switch int/float lists between the text format
+ * ("[1,2,3,]") and a binary format (element count, data type and the raw
+ * contiguous elements). Binary lists are read straight into the vector and
+ * keep full float precision.
+ * Note: Both ends of the connection must use the same setting.
+ * @param enable True to send lists in binary format
+ */
+void EzCppSocket::setBinaryLists(bool enable)
+{
+	this->binary_lists = enable;
+}
+
+/**
+ * @brief A getter function to check if lists are sent in binary format
+ * 
+ * @return true Lists are sent as raw elements
+ * @return false Lists are sent as text
+ */
+bool EzCppSocket::getBinaryLists()
+{
+	return this->binary_lists;
+}
+
+/**
+ * @brief A setter function to choose how a loop with loop_count 0 ends.
+ * By default the client sends a status string ("Active"/"Stop") after every
+ * iteration and the server reads it after every callback. When enabled, the
+ * client sends a single stop message when its loop ends and the server peeks
+ * at the next message after each callback, so iterations carry nothing but
+ * user data. This needs the client to send first in every iteration; a server
+ * callback that sends before reading would wait on the peek forever.
+ * It stays disabled by default, since loops whose server sends first and peers
+ * built before this option only work with the status string protocol.
+ * Note: Both ends of the connection must use the same setting.
+ * @param enable True to end loops with a single stop message (default false)
+ */
+void EzCppSocket::setLoopStopMessage(bool enable)
+{
+	this->loop_stop_message = enable;
+}
+
+/**
+ * @brief A getter function to check if loops end with a single stop message
+ * 
+ * @return true Loops end with a single stop message
+ * @return false A status string is exchanged after every iteration
+ */
+bool EzCppSocket::getLoopStopMessage()
+{
+	return this->loop_stop_message;
+}
+
 /**
  * @brief Getter function to get loop status
  * 
@@ -249,11 +549,19 @@ void EzCppSocket::loop_func_decorator(void (*func_ptr)(EzCppSocket&), bool show_
  * @param loop_count 
  * Looping behaviour:
  *   if -1, loops until stop_loop is called on server side,
- *   if 0, loops until stop_loop is called from client side (Status string is sent)
+ *   if 0, loops until stop_loop is called from client side (by default a status
+ *   string is read after every iteration, which keeps server callbacks that send
+ *   first and older peers working; see setLoopStopMessage to drop it)
  *   else, loops for as many iterations as specified]. Defaults to 0.
  * @param show_ips Bool flag to display IPS (iterations per second)
  */
 void EzCppSocket::serverLoop(void (*func_ptr)(EzCppSocket&), int loop_count, bool show_ips){
+	if (this->client_connection_count > 1)
+	{
+		this->multiClientServerLoop(func_ptr, loop_count, show_ips);
+		return;
+	}
+
 	this->loop_flag = true;
 	this->loop_start_time = std::chrono::high_resolution_clock::now();
 
@@ -262,6 +570,13 @@ void EzCppSocket::serverLoop(void (*func_ptr)(EzCppSocket&), int loop_count, boo
 			loop_func_decorator(func_ptr, show_ips);
 	}
 
+	else if (loop_count == 0 && this->loop_stop_message){
+		// Server is up until the client stops its loop. The client only sends a
+		// stop message when it is done, so iterations carry nothing but user data.
+		do
+			loop_func_decorator(func_ptr, show_ips);
+		while (!this->readLoopStop());
+	}
 	else if (loop_count == 0){
 		// Server is up until Client has gotten its request
 		std::string status = "Active";
@@ -279,13 +594,248 @@ void EzCppSocket::serverLoop(void (*func_ptr)(EzCppSocket&), int loop_count, boo
 	this->resetLoop();
 }
 
+/**
+ * @brief Accept a pending connection on the server socket
+ * 
+ * @return EzCppSocket* Object for the new connection (nullptr on failure)
+ */
+EzCppSocket *EzCppSocket::acceptConnection()
+{
+	struct sockaddr_storage client_addr;
+	socklen_t addrlen = sizeof(client_addr);
+	int connection_sock = accept(this->fd, (struct sockaddr *)&client_addr, &addrlen);
+	if (connection_sock < 0)
+	{
+		perror("accept");
+		return nullptr;
+	}
+
+	this->printPeerAddress(client_addr);
+	printf("Connection established ...\n");
+
+	EzCppSocket *connection = new EzCppSocket(*this, connection_sock);
+	connection->loop_flag = true;
+	connection->loop_start_time = std::chrono::high_resolution_clock::now();
+	return connection;
+}
+
+/**
+ * @brief Run one iteration of the server loop on a connection that has data
+ * ready. Follows the looping behaviour of serverLoop for that connection.
+ * 
+ * @param connection Connection to be served
+ * @param func_ptr Pointer to function that should be part of the server loop
+ * @param loop_count Looping behaviour (see serverLoop)
+ * @param show_ips Bool flag to display IPS (iterations per second)
+ * @return true Connection stays open
+ * @return false Connection is done and should be closed
+ */
+bool EzCppSocket::serveConnection(EzCppSocket &connection, void (*func_ptr)(EzCppSocket&), int loop_count, bool show_ips)
+{
+	try
+	{
+		// The connection has data ready, which is either the client's next
+		// iteration or its loop stop message. Keep going while data of the next
+		// message is already buffered, epoll would not report it again.
+		do
+		{
+			if (loop_count == 0 && connection.loop_stop_message && connection.readLoopStop())
+				return false;
+
+			connection.loop_func_decorator(func_ptr, show_ips);
+
+			if (loop_count == 0 && !connection.loop_stop_message && connection.readString().compare("Stop") == 0)
+				return false;
+			if (loop_count > 0 && connection.loop_iteration_count >= (unsigned int)loop_count)
+				return false;
+		} while (connection.loop_flag && connection.hasBufferedData());
+		return connection.loop_flag;
+	}
+	catch (const std::exception &e)
+	{
+		printf("Closing connection : %s\n", e.what());
+		return false;
+	}
+}
+
+/**
+ * @brief Server loop for a server that accepts up to client_connection_count
+ * clients. All connections are multiplexed with epoll on the calling thread and
+ * func_ptr is called with the object of whichever connection has data ready, so
+ * each connection keeps its own framing state and loop counters.
+ * The loop ends when stopLoop is called on the server, or (for loop_count >= 0)
+ * once client_connection_count clients have been served and have disconnected.
+ * With loop_count -1, slots freed by closed connections are given to new clients.
+ * Calling stopLoop on a connection closes that connection.
+ * With setWorkerThreads > 1 the callbacks of different connections run in
+ * parallel on a thread pool, while epoll keeps running on the calling thread.
+ * 
+ * @param func_ptr Pointer to function that should be part of the server loop
+ * @param loop_count Looping behaviour (see serverLoop), applied per connection
+ * @param show_ips Bool flag to display IPS (iterations per second)
+ */
+void EzCppSocket::multiClientServerLoop(void (*func_ptr)(EzCppSocket&), int loop_count, bool show_ips)
+{
+	this->loop_flag = true;
+	this->loop_start_time = std::chrono::high_resolution_clock::now();
+
+	int epoll_fd = epoll_create1(0);
+	if (epoll_fd < 0)
+	{
+		perror("epoll_create1");
+		exit(EXIT_FAILURE);
+	}
+
+	struct epoll_event event = {};
+	event.events = EPOLLIN;
+	event.data.fd = this->fd;
+	epoll_ctl(epoll_fd, EPOLL_CTL_ADD, this->fd, &event);
+	bool accepting = true;
+
+	std::map<int, std::unique_ptr<EzCppSocket>> connections;
+	int served_count = 0;
+	std::vector<struct epoll_event> events(this->client_connection_count + 2);
+
+	// With worker threads, a connection is disarmed (EPOLLONESHOT) while a
+	// worker serves it. The worker re-arms it, or queues it to be closed here
+	// and wakes this loop through done_fd.
+	std::unique_ptr<EzThreadPool> pool;
+	int done_fd = -1;
+	std::mutex done_mutex;
+	std::vector<int> done_connections;
+	uint32_t connection_events = EPOLLIN;
+	if (this->worker_threads > 1)
+	{
+		pool.reset(new EzThreadPool(this->worker_threads));
+		done_fd = eventfd(0, EFD_NONBLOCK);
+		if (done_fd < 0)
+		{
+			perror("eventfd");
+			exit(EXIT_FAILURE);
+		}
+		event.data.fd = done_fd;
+		epoll_ctl(epoll_fd, EPOLL_CTL_ADD, done_fd, &event);
+		connection_events |= EPOLLONESHOT;
+	}
+
+	while (this->loop_flag)
+	{
+		if (loop_count >= 0 && served_count >= this->client_connection_count && connections.empty())
+			break;
+
+		// Only wait on the server socket while there is a free slot
+		bool slot_free = (int)connections.size() < this->client_connection_count &&
+						 (loop_count == -1 || served_count < this->client_connection_count);
+		if (slot_free != accepting)
+		{
+			event.data.fd = this->fd;
+			epoll_ctl(epoll_fd, slot_free ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, this->fd, &event);
+			accepting = slot_free;
+		}
+
+		// Timeout so that stopLoop is noticed even when no client is active
+		int ready = epoll_wait(epoll_fd, events.data(), events.size(), 500);
+		if (ready < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			perror("epoll_wait");
+			break;
+		}
+
+		for (int i = 0; i < ready; i++)
+		{
+			int ready_fd = events[i].data.fd;
+			if (ready_fd == done_fd)
+			{
+				uint64_t counter;
+				if (read(done_fd, &counter, sizeof(counter)) < 0 && errno != EAGAIN)
+					perror("read");
+				std::vector<int> closed;
+				{
+					std::lock_guard<std::mutex> lock(done_mutex);
+					closed.swap(done_connections);
+				}
+				for (int closed_fd : closed)
+				{
+					epoll_ctl(epoll_fd, EPOLL_CTL_DEL, closed_fd, nullptr);
+					connections.erase(closed_fd);
+					printf("Connection closed, %zu connection(s) active ...\n", connections.size());
+				}
+				continue;
+			}
+
+			if (ready_fd == this->fd)
+			{
+				if (!accepting)
+					continue;
+				EzCppSocket *connection = this->acceptConnection();
+				if (connection == nullptr)
+					continue;
+				struct epoll_event connection_event = {};
+				connection_event.events = connection_events;
+				connection_event.data.fd = connection->sock;
+				epoll_ctl(epoll_fd, EPOLL_CTL_ADD, connection->sock, &connection_event);
+				connections[connection->sock].reset(connection);
+				served_count++;
+				continue;
+			}
+
+			auto connection = connections.find(ready_fd);
+			if (connection == connections.end())
+				continue;
+			if (pool)
+			{
+				EzCppSocket *worker_connection = connection->second.get();
+				pool->submit([this, worker_connection, func_ptr, loop_count, show_ips, ready_fd, epoll_fd, done_fd,
+							  connection_events, &done_mutex, &done_connections]() {
+					if (this->serveConnection(*worker_connection, func_ptr, loop_count, show_ips))
+					{
+						struct epoll_event rearm = {};
+						rearm.events = connection_events;
+						rearm.data.fd = ready_fd;
+						epoll_ctl(epoll_fd, EPOLL_CTL_MOD, ready_fd, &rearm);
+						return;
+					}
+					{
+						std::lock_guard<std::mutex> lock(done_mutex);
+						done_connections.push_back(ready_fd);
+					}
+					uint64_t one = 1;
+					if (write(done_fd, &one, sizeof(one)) < 0)
+						perror("write");
+				});
+			}
+			else if (!this->serveConnection(*connection->second, func_ptr, loop_count, show_ips))
+			{
+				epoll_ctl(epoll_fd, EPOLL_CTL_DEL, ready_fd, nullptr);
+				connections.erase(connection);
+				printf("Connection closed, %zu connection(s) active ...\n", connections.size());
+			}
+		}
+	}
+
+	if (pool)
+	{
+		// Unblock workers still waiting on their clients before joining them
+		for (auto &connection : connections)
+			shutdown(connection.second->sock, SHUT_RDWR);
+		pool.reset();
+		close(done_fd);
+	}
+	connections.clear();
+	close(epoll_fd);
+	this->resetLoop();
+}
+
 /**
  * @brief Loop to run client
  * 
  * @param func_ptr Pointer to the function that should be part of client loop
  * @param loop_count 
  * Looping behaviour
- *	if 0, loops until stop_loop is called from client side
+ *	if 0, loops until stop_loop is called from client side (by default a status
+ *	string is sent after every iteration, see setLoopStopMessage)
  *	else, loops for as many iterations as specified]. Defaults to 0.
  * @param show_ips Bool flag to display IPS (iterations per second)
  */
@@ -293,7 +843,13 @@ void EzCppSocket::clientLoop(void (*func_ptr)(EzCppSocket&), int loop_count, boo
 	this->loop_flag = true;
 	this->loop_start_time = std::chrono::high_resolution_clock::now();
 
-	if (loop_count == 0){
+	if (loop_count == 0 && this->loop_stop_message){
+		// Client is up until stopLoop is called, then tells the server to stop
+		while (this->loop_flag)
+			loop_func_decorator(func_ptr, show_ips);
+		this->sendLoopStop();
+	}
+	else if (loop_count == 0){
 		// Server is up until Client has gotten its request
 		std::string status = "Active";
 		while (status.compare("Stop") != 0){
@@ -342,21 +898,20 @@ void EzCppSocket::insertTokens(std::string &msg)
 }
 
 /**
- * @brief Extracting tokens from the received messages to get the actual message.
- * This also serves as a check on the validity of the message. Currently throws
- * an error if invalid message is received.
- * @param msg 
+ * @brief Check the tokens around a received message in place. This serves as a
+ * check on the validity of the message. Currently prints an error if an invalid
+ * message is received.
+ * @param msg Received message including tokens
+ * @param size Size of the received message in bytes
+ * @return true Both tokens were found
+ * @return false A token check failed
  */
-void EzCppSocket::extractTokens(std::string &msg)
+bool EzCppSocket::checkTokens(const uchar *msg, size_t size)
 {
+	const std::string &start_token = this->tokens.first, &end_token = this->tokens.second;
 	try
 	{
-		// Start token extraction
-		if (msg.find(this->tokens.first) == 0)
-		{
-			msg = msg.substr(this->tokens.first.length());
-		}
-		else
+		if (size < start_token.length() || memcmp(msg, start_token.data(), start_token.length()) != 0)
 		{
 			std::cout << "Starting token was not found at the beginning of message received!"
 					  << " Please check if the right kind of data is being sent/received or that"
@@ -364,401 +919,3787 @@ void EzCppSocket::extractTokens(std::string &msg)
 			throw "Starting token check in received message failed";
 		}
 
-		// End token extraction
-		if (msg.rfind(this->tokens.second) == (msg.length() - this->tokens.second.length()))
-		{
-			msg = msg.substr(0, msg.length() - this->tokens.second.length());
-		}
-		else
+		if (size < start_token.length() + end_token.length() ||
+			memcmp(msg + size - end_token.length(), end_token.data(), end_token.length()) != 0)
 		{
 			std::cout << "Ending token was not found at the end of message received!"
 					  << " Please check if the right kind of data is being sent/received or that"
-					  << " the same tokens are set on server and client ends...\n"
-					  << "Additionally, try increasing setSleepBetweenPackets value.\n"
-					  << "Current sleep_between_packets value: " << this->getSleepBetweenPackets() << "\n";
+					  << " the same tokens are set on server and client ends...\n";
 			throw "Ending token check in received message failed";
 		}
 	}
 	catch (const char *msg)
 	{
 		perror(msg);
+		return false;
 	}
+	return true;
 }
 
-// Incoming
-
 /**
- * @brief Read bool value received on port
- * 
- * @return std::pair<bool, bool> Receive (received_flag, received_bool)
+ * @brief Read a token directly off the socket and check it against the expected
+ * token. Used where the payload is read straight into its destination buffer
+ * instead of going through extractTokens.
+ * @param token Expected token
+ * @param start_token True if this is the start token, false for the end token
  */
-std::pair<bool, bool> EzCppSocket::readBool()
+void EzCppSocket::readToken(const std::string &token, bool start_token)
 {
-	bool ret = true, value = false;
-	try
-	{
-		std::string received = this->readString();
-		if (!received.compare("true") || !received.compare("1")) // If strings match, compare gives 0
-			value = true;
-		else if (!received.compare("false") || !received.compare("0"))
-			;
-		else
-		{
-			ret = false;
-			throw(received);
-		}
-	}
-	catch (std::string message)
+	if (token.empty())
+		return;
+
+	uchar *received = this->reserveReceiveBuffer(token.length());
+	this->readFully(received, token.length());
+	if (memcmp(received, token.data(), token.length()) != 0)
 	{
-		printf("\n Message received: %s", message.c_str());
-		printf("\n Unable to collect proper boolean information from message.\n");
+		std::cout << (start_token ? "Starting" : "Ending") << " token was not found in message received!"
+				  << " Please check if the right kind of data is being sent/received or that"
+				  << " the same tokens are set on server and client ends...\n";
+		perror(start_token ? "Starting token check in received message failed" : "Ending token check in received message failed");
 	}
-	return std::pair<bool, bool>(ret, value);
 }
 
 /**
- * @brief Read message received on port
+ * @brief Write a 32 bit unsigned value in little-endian byte order
  * 
- * @return std::string  Received buffer
+ * @param buffer Destination (at least 4 bytes)
+ * @param value Value to be written
  */
-std::string EzCppSocket::readString()
+void EzCppSocket::putUint32(uchar *buffer, uint32_t value)
 {
-	const int buffer_size = this->readInt();
-	char buffer[buffer_size] = {0};
-	int valread = read(sock, buffer, buffer_size);
-
-	std::string str(&buffer[0], &buffer[buffer_size]);
-	this->extractTokens(str);
-
-	if (this->debug)
-	{
-		printf("readString buffer received: %s\n", buffer);
-		printf("Final string : %s\n", str.c_str());
-	}
-
-	return str;
+	for (int i = 0; i < 4; i++)
+		buffer[i] = (value >> (8 * i)) & 0xFF;
 }
 
 /**
- * @brief Read integer value received on port
+ * @brief Read a 32 bit unsigned value stored in little-endian byte order
  * 
- * @param buffer_size Size of buffer to be read (in bytes)
- * @return int Received integer
+ * @param buffer Source (at least 4 bytes)
+ * @return uint32_t Value read
  */
-int EzCppSocket::readInt(const int buffer_size)
+uint32_t EzCppSocket::getUint32(const uchar *buffer)
 {
-	const int token_compensated_buffer_size = this->tokens.first.length() + buffer_size + this->tokens.second.length();
-	char buffer[token_compensated_buffer_size] = {0};
-	int valread = read(sock, buffer, token_compensated_buffer_size);
+	uint32_t value = 0;
+	for (int i = 0; i < 4; i++)
+		value |= (uint32_t)buffer[i] << (8 * i);
+	return value;
+}
 
-	std::string str(&buffer[0], &buffer[token_compensated_buffer_size]);
-	this->extractTokens(str);
+/**
+ * @brief Check a received Mat header before anything is allocated for it. An
+ * empty Mat must not carry pixel data; otherwise the type has to be a valid
+ * OpenCV type, every row has to fit in step bytes and the pixel data in
+ * max_size bytes.
+ * @param rows Number of rows
+ * @param cols Number of columns
+ * @param type OpenCV type (CV_MAKETYPE)
+ * @param step Number of bytes per row
+ * @param max_size Largest number of pixel bytes accepted
+ * @return bool True if the header is valid
+ */
+bool EzCppSocket::validMatHeader(uint32_t rows, uint32_t cols, uint32_t type, uint32_t step, size_t max_size)
+{
+	if (rows == 0 || cols == 0)
+		return rows == 0 || step == 0;
+	if (rows > INT_MAX || cols > INT_MAX || type != (type & CV_MAT_TYPE_MASK))
+		return false;
+	return step >= (uint64_t)cols * CV_ELEM_SIZE(type) && (uint64_t)rows * step <= max_size;
+}
 
-	if (this->debug)
+/**
+ * @brief Size of a single element of the given data type
+ * 
+ * @param dtype Data type
+ * @return size_t Size in bytes (0 if unknown)
+ */
+size_t EzCppSocket::dataTypeSize(DataType dtype)
+{
+	switch (dtype)
 	{
-		printf("readInt buffer received: '%s' \n", buffer);
-		printf("Converted int : %i\n", std::stoi(str));
+	case DTYPE_UINT8:
+	case DTYPE_INT8:
+		return 1;
+	case DTYPE_UINT16:
+	case DTYPE_INT16:
+		return 2;
+	case DTYPE_INT32:
+	case DTYPE_FLOAT32:
+		return 4;
+	case DTYPE_INT64:
+	case DTYPE_FLOAT64:
+		return 8;
+	default:
+		return 0;
 	}
-
-	return std::stoi(str);
 }
 
 /**
- * @brief Read float value received on port
- * 
- * @param buffer_size Size of buffer to be read (in bytes)
- * @return int Received float
+ * @brief Read the headers of a binary list up to the first element. The caller
+ * reads the elements and the end token.
+ * @param type Type of message expected
+ * @param expected_dtype Data type of the elements expected
+ * @return size_t Number of elements that follow
  */
-float EzCppSocket::readFloat(const int buffer_size)
+size_t EzCppSocket::readListHeader(MessageType type, DataType expected_dtype)
 {
-	const int token_compensated_buffer_size = this->tokens.first.length() + buffer_size + this->tokens.second.length();
-	char buffer[token_compensated_buffer_size] = {0};
-	int valread = read(sock, buffer, token_compensated_buffer_size);
+	const unsigned int payload_size = this->readHeader(type);
+	this->readToken(this->tokens.first, true);
 
-	std::string str(&buffer[0], &buffer[token_compensated_buffer_size]);
-	this->extractTokens(str);
+	uchar list_header[list_header_size] = {0};
+	this->readFully(list_header, list_header_size);
+	const DataType dtype = static_cast<DataType>(list_header[0]);
+	const size_t count = getUint32(list_header + 4);
 
 	if (this->debug)
+		std::cout << "Received list header, data type : " << int(dtype) << " element count : " << count << "\n";
+
+	// The caller allocates count elements, so bound them before the header is accepted
+	this->checkMessageSize(count * dataTypeSize(dtype));
+
+	if (dtype != expected_dtype ||
+		payload_size != this->tokens.first.length() + list_header_size + count * dataTypeSize(dtype) + this->tokens.second.length())
 	{
-		printf("readFloat buffer received: %s\n", buffer);
-		printf("Converted float : %f\n", std::stof(str));
+		std::cout << "Received list of data type " << int(dtype) << " while expecting data type " << int(expected_dtype) << "!"
+				  << " Please check if the right kind of data is being sent/received or that"
+				  << " binary lists are set on both server and client ends...\n";
+		throw std::runtime_error("List header check in received message failed");
 	}
-
-	return std::stof(str);
+	return count;
 }
 
 /**
- * @brief Read a list of integer values
+ * @brief Send a list as a binary list header followed by the raw elements
  * 
- * @return std::vector<int> Integer List received
+ * @param type Type of message being sent
+ * @param dtype Data type of the elements
+ * @param data Pointer to the first element
+ * @param count Number of elements
  */
-std::vector<int> EzCppSocket::readIntList()
+void EzCppSocket::sendList(MessageType type, DataType dtype, const void *data, size_t count)
 {
-	const int buffer_size = this->readInt(); // get message size
-	char buffer[buffer_size] = {0};
-	int valread = read(sock, buffer, buffer_size);
+	const size_t data_size = count * dataTypeSize(dtype);
 
-	// remove the [] characters around the received list
-	std::string str(&buffer[0], &buffer[buffer_size]);
-	this->extractTokens(str);
-	str = str.substr(1, str.find("]") - 1);
+	uchar list_header[list_header_size] = {0};
+	list_header[0] = dtype;
+	putUint32(list_header + 4, count);
 
-	std::stringstream ss(str);
-	std::string ss_elem; // substring
-	std::vector<int> v;
-	while (getline(ss, ss_elem, ','))
+	if (this->debug)
+		std::cout << "Sending list, data type : " << int(dtype) << " element count : " << count << "\n";
+
+	this->sendFrame(type, {{list_header, list_header_size}, {const_cast<void *>(data), data_size}});
+}
+
+/**
+ * @brief Read the headers of a tensor up to the first element. The caller
+ * reads the elements and the end token.
+ * @param expected_dtype Data type of the elements expected
+ * @return std::vector<size_t> Shape of the tensor
+ */
+std::vector<size_t> EzCppSocket::readTensorHeader(DataType expected_dtype)
+{
+	const unsigned int payload_size = this->readHeader(MSG_TENSOR);
+	this->readToken(this->tokens.first, true);
+
+	uchar tensor_header[tensor_header_size] = {0};
+	this->readFully(tensor_header, tensor_header_size);
+	const DataType dtype = static_cast<DataType>(tensor_header[0]);
+
+	const size_t dims_size = 4 * tensor_header[1];
+	uchar *dims = this->reserveReceiveBuffer(dims_size);
+	this->readFully(dims, dims_size);
+	std::vector<size_t> shape(tensor_header[1]);
+	size_t count = 1;
+	// The shape comes from the peer, so the element count is checked against the
+	// maximum message size at each step instead of being allowed to overflow
+	const size_t max_count = dataTypeSize(dtype) ? this->max_message_size / dataTypeSize(dtype) : 0;
+	for (size_t i = 0; i < shape.size(); i++)
+	{
+		shape[i] = getUint32(dims + 4 * i);
+		if (shape[i] != 0 && count > max_count / shape[i])
+		{
+			std::cout << "Received tensor shape has more elements than fit in the maximum message size "
+					  << this->max_message_size << "! Use setMaxMessageSize to allow larger messages.\n";
+			throw std::runtime_error("Tensor header check in received message failed");
+		}
+		count *= shape[i];
+	}
+
+	if (this->debug)
+		std::cout << "Received tensor header, data type : " << int(dtype) << " dimensions : " << shape.size()
+				  << " element count : " << count << "\n";
+
+	if (dtype != expected_dtype ||
+		payload_size != this->tokens.first.length() + tensor_header_size + dims_size + count * dataTypeSize(dtype) + this->tokens.second.length())
+	{
+		std::cout << "Received tensor of data type " << int(dtype) << " while expecting data type " << int(expected_dtype) << "!"
+				  << " Please check if the right kind of data is being sent/received...\n";
+		throw std::runtime_error("Tensor header check in received message failed");
+	}
+	return shape;
+}
+
+/**
+ * @brief Send a tensor as a tensor header (data type and shape) followed by the raw elements
+ * 
+ * @param dtype Data type of the elements
+ * @param data Pointer to the first element
+ * @param shape Size of each dimension
+ */
+void EzCppSocket::sendTensorData(DataType dtype, const void *data, const std::vector<size_t> &shape)
+{
+	if (shape.size() > UINT8_MAX)
+		throw std::invalid_argument("Tensors can have at most 255 dimensions");
+	for (size_t dim : shape)
+		if (dim > UINT32_MAX)
+			throw std::invalid_argument("Tensor dimensions must be smaller than 2^32");
+
+	size_t count = 1;
+	std::vector<uchar> tensor_header(tensor_header_size + 4 * shape.size(), 0);
+	tensor_header[0] = dtype;
+	tensor_header[1] = shape.size();
+	for (size_t i = 0; i < shape.size(); i++)
+	{
+		putUint32(&tensor_header[tensor_header_size + 4 * i], shape[i]);
+		count *= shape[i];
+	}
+	const size_t data_size = count * dataTypeSize(dtype);
+
+	if (this->debug)
+		std::cout << "Sending tensor, data type : " << int(dtype) << " dimensions : " << shape.size()
+				  << " element count : " << count << "\n";
+
+	this->sendFrame(MSG_TENSOR, {{tensor_header.data(), tensor_header.size()}, {const_cast<void *>(data), data_size}});
+}
+
+/**
+ * @brief Send a complete message: header, start token, payload and end token are
+ * gathered into a single scatter-gather write, so no intermediate copies or
+ * string concatenations are made and small messages go out in one syscall.
+ * With binary framing the header is a fixed width frame header, else the
+ * 16 digit size string that sendInt would send.
+ * @param type Type of message being sent
+ * @param payload Buffers that make up the payload, in order
+ * @param flags Frame flags (binary framing only)
+ * @param codec Image codec (binary framing only)
+ */
+void EzCppSocket::sendFrame(MessageType type, const std::vector<struct iovec> &payload, uint8_t flags, uint8_t codec)
+{
+	uchar header[frame_header_size];
+	std::string size_message;
+	std::vector<struct iovec> message = this->buildFrame(type, payload, flags, codec, header, size_message);
+	this->writeVectorFully(message.data(), message.size());
+}
+
+/**
+ * @brief Gather the buffers of a complete message (see sendFrame). The header
+ * is written to header or size_message, which must outlive the returned buffers.
+ * Payloads are compressed here when setCompression is used.
+ * @param type Type of message being sent
+ * @param payload Buffers that make up the payload, in order
+ * @param flags Frame flags (binary framing only)
+ * @param codec Image codec (binary framing only)
+ * @param header Storage for the binary frame header
+ * @param size_message Storage for the text size header
+ * @return std::vector<struct iovec> Buffers to be written, in order
+ */
+std::vector<struct iovec> EzCppSocket::buildFrame(MessageType type, const std::vector<struct iovec> &payload, uint8_t flags, uint8_t codec,
+												  uchar (&header)[frame_header_size], std::string &size_message)
+{
+	size_t payload_size = this->tokens.first.length() + this->tokens.second.length();
+	for (auto &part : payload)
+		payload_size += part.iov_len;
+
+	memset(header, 0, frame_header_size);
+	std::vector<struct iovec> message;
+	message.reserve(payload.size() + 3);
+
+	// The header is filled in once the (possibly compressed) payload size is known
+	message.push_back({header, 0});
+	message.push_back({const_cast<char *>(this->tokens.first.data()), this->tokens.first.length()});
+	message.insert(message.end(), payload.begin(), payload.end());
+	message.push_back({const_cast<char *>(this->tokens.second.data()), this->tokens.second.length()});
+	flags |= this->compressMessage(type, codec, message, payload_size);
+
+	if (this->binary_framing)
+	{
+		if (payload_size > UINT32_MAX)
+		{
+			std::cout << "Message of " << payload_size << " bytes does not fit in a binary frame of at most "
+					  << UINT32_MAX << " bytes!\n";
+			throw std::runtime_error("Message is too large for binary framing");
+		}
+		putUint32(header, payload_size);
+		header[4] = type;
+		header[5] = flags;
+		header[6] = codec;
+		message[0] = {header, frame_header_size};
+	}
+	else
+	{
+		std::string size_str = std::to_string(payload_size);
+		size_message = this->tokens.first + std::string(16 - size_str.length(), '0') + size_str + this->tokens.second;
+		message[0] = {&size_message[0], size_message.length()};
+	}
+
+	if (this->debug)
+		std::cout << "Sending message, type : " << int(type) << " payload size : " << payload_size << "\n";
+	return message;
+}
+
+/**
+ * @brief Compress the tokens and payload of a message (message[1] onwards) if
+ * compression is set, the type carries compressible data and the payload is at
+ * least compression_threshold bytes. Encoded images are never compressed again.
+ * The message is left alone if compressing does not make it smaller.
+ * @param type Type of message being sent
+ * @param codec Image codec of the message
+ * @param message Buffers of the message, replaced by the compressed message
+ * @param payload_size Size of the tokens and payload, updated to the compressed size
+ * @return uint8_t Frame flag of the compression used (0 if not compressed)
+ */
+uint8_t EzCppSocket::compressMessage(MessageType type, uint8_t codec, std::vector<struct iovec> &message, size_t &payload_size)
+{
+	const bool compressible = type == MSG_STRING || type == MSG_INT_LIST || type == MSG_FLOAT_LIST || type == MSG_MAT ||
+							  type == MSG_TENSOR || ((type == MSG_IMAGE || type == MSG_IMAGE_BATCH) && codec == CODEC_RAW);
+	if (this->compression == COMPRESSION_NONE || !this->binary_framing || !compressible ||
+		payload_size < this->compression_threshold || payload_size > INT_MAX)
+		return 0;
+
+	this->compress_input.resize(payload_size);
+	size_t offset = 0;
+	for (size_t i = 1; i < message.size(); i++)
+	{
+		memcpy(this->compress_input.data() + offset, message[i].iov_base, message[i].iov_len);
+		offset += message[i].iov_len;
+	}
+
+	size_t compressed_size = 0;
+	uint8_t flag = 0;
+#ifdef EZCPPSOCKET_WITH_LZ4
+	if (this->compression == COMPRESSION_LZ4)
+	{
+		const int bound = LZ4_compressBound(payload_size);
+		this->compress_output.resize(compression_header_size + bound);
+		const int result = LZ4_compress_default(reinterpret_cast<const char *>(this->compress_input.data()),
+												reinterpret_cast<char *>(this->compress_output.data() + compression_header_size),
+												payload_size, bound);
+		compressed_size = std::max(result, 0);
+		flag = FLAG_LZ4;
+	}
+#endif
+#ifdef EZCPPSOCKET_WITH_ZSTD
+	if (this->compression == COMPRESSION_ZSTD)
+	{
+		const size_t bound = ZSTD_compressBound(payload_size);
+		this->compress_output.resize(compression_header_size + bound);
+		const size_t result = ZSTD_compress(this->compress_output.data() + compression_header_size, bound,
+											this->compress_input.data(), payload_size,
+											this->compression_level != 0 ? this->compression_level : ZSTD_CLEVEL_DEFAULT);
+		compressed_size = ZSTD_isError(result) ? 0 : result;
+		flag = FLAG_ZSTD;
+	}
+#endif
+	if (compressed_size == 0 || compression_header_size + compressed_size >= payload_size)
+		return 0;
+
+	if (this->debug)
+		std::cout << "Compressed payload of size " << payload_size << " to " << compressed_size << "\n";
+
+	putUint32(this->compress_output.data(), payload_size);
+	payload_size = compression_header_size + compressed_size;
+	message.resize(1);
+	message.push_back({this->compress_output.data(), payload_size});
+	return flag;
+}
+
+/**
+ * @brief Decompress the message whose frame header was just parsed, if its
+ * flags say it is compressed. The decompressed message is read before the
+ * socket by the following reads, so callers read it like any other message.
+ * @param message_size Size of the message on the wire
+ * @return size_t Size of the (decompressed) message
+ */
+size_t EzCppSocket::inflateMessage(size_t message_size)
+{
+	if (!(this->received_flags & (FLAG_LZ4 | FLAG_ZSTD)))
+		return message_size;
+
+	this->checkMessageSize(message_size);
+	if (this->inflate_input.size() < message_size)
+		this->inflate_input.resize(message_size);
+	this->readFully(this->inflate_input.data(), message_size);
+	this->inflate_end = this->decompress(this->inflate_input.data(), message_size);
+	this->inflate_begin = 0;
+	return this->inflate_end;
+}
+
+/**
+ * @brief Decompress a compressed message (see compression_header_size) into
+ * inflate_buffer, with the method named by received_flags
+ * @param message Compressed message
+ * @param message_size Size of the compressed message
+ * @return size_t Size of the decompressed message
+ */
+size_t EzCppSocket::decompress(const uchar *message, size_t message_size)
+{
+	if (message_size < compression_header_size)
+		throw std::runtime_error("Compressed message check in received message failed");
+	const size_t size = getUint32(message);
+	if (size > this->max_message_size)
+	{
+		std::cout << "Received message size " << size << " is larger than the maximum message size "
+				  << this->max_message_size << "! Use setMaxMessageSize to allow larger messages.\n";
+		throw std::runtime_error("Message size check in received message failed");
+	}
+	// One spare byte, so the payload can be null terminated in place
+	if (this->inflate_buffer.size() < size + 1)
+		this->inflate_buffer.resize(size + 1);
+
+	const size_t compressed_size = message_size - compression_header_size;
+	bool decompressed = false;
+	if (this->received_flags & FLAG_LZ4)
+	{
+#ifdef EZCPPSOCKET_WITH_LZ4
+		decompressed = LZ4_decompress_safe(reinterpret_cast<const char *>(message + compression_header_size),
+										   reinterpret_cast<char *>(this->inflate_buffer.data()),
+										   compressed_size, size) == (int)size;
+#else
+		throw std::runtime_error("Received an LZ4 compressed message, build with EZCPPSOCKET_WITH_LZ4 to read it");
+#endif
+	}
+	else
+	{
+#ifdef EZCPPSOCKET_WITH_ZSTD
+		decompressed = ZSTD_decompress(this->inflate_buffer.data(), size, message + compression_header_size, compressed_size) == size;
+#else
+		throw std::runtime_error("Received a zstd compressed message, build with EZCPPSOCKET_WITH_ZSTD to read it");
+#endif
+	}
+	if (!decompressed)
+		throw std::runtime_error("Decompressing received message failed");
+
+	if (this->debug)
+		std::cout << "Decompressed payload of size " << compressed_size << " to " << size << "\n";
+	return size;
+}
+
+/**
+ * @brief A setter function to compress outgoing payloads (binary framing only).
+ * Strings, lists, tensors and raw Mats/images of at least threshold bytes are
+ * compressed, the frame flags tell the receiver to decompress them. Both ends
+ * need the method compiled in (EZCPPSOCKET_WITH_LZ4 / EZCPPSOCKET_WITH_ZSTD) to
+ * read compressed messages.
+ * @param method COMPRESSION_NONE, COMPRESSION_LZ4 (fast) or COMPRESSION_ZSTD (better ratio)
+ * @param level zstd compression level (0 uses the zstd default, ignored by LZ4)
+ * @param threshold Smallest payload in bytes that gets compressed
+ */
+void EzCppSocket::setCompression(Compression method, int level, size_t threshold)
+{
+#ifndef EZCPPSOCKET_WITH_LZ4
+	if (method == COMPRESSION_LZ4)
+	{
+		printf("LZ4 support is not compiled in, build with -DEZCPPSOCKET_WITH_LZ4 and link with -llz4\n");
+		return;
+	}
+#endif
+#ifndef EZCPPSOCKET_WITH_ZSTD
+	if (method == COMPRESSION_ZSTD)
+	{
+		printf("zstd support is not compiled in, build with -DEZCPPSOCKET_WITH_ZSTD and link with -lzstd\n");
+		return;
+	}
+#endif
+	if (method > COMPRESSION_ZSTD)
+	{
+		printf("Unknown compression method %d\n", method);
+		return;
+	}
+	this->compression = method;
+	this->compression_level = level;
+	this->compression_threshold = threshold;
+}
+
+/**
+ * @brief A getter function for the compression of outgoing payloads
+ * @return Compression Compression method
+ */
+EzCppSocket::Compression EzCppSocket::getCompression()
+{
+	return this->compression;
+}
+
+/**
+ * @brief A setter function to set the largest message that will be accepted.
+ * Message sizes come from the peer, so this bounds how much memory a single
+ * (possibly corrupt) header can make the receive buffer grow to.
+ * @param number_of_bytes Maximum message size in bytes
+ */
+void EzCppSocket::setMaxMessageSize(size_t number_of_bytes)
+{
+	this->max_message_size = number_of_bytes;
+}
+
+/**
+ * @brief A setter function for the size of the datagrams a message is split
+ * into with SOCK_DGRAM (fragment header included). The default of 1400 bytes
+ * fits a 1500 byte Ethernet MTU, so no datagram is fragmented by IP, where
+ * losing one IP fragment would lose the whole datagram. Raise it on networks
+ * with a larger MTU (e.g. loopback) to send fewer datagrams per frame.
+ * Each end can use its own size.
+ * @param number_of_bytes Datagram size in bytes
+ */
+void EzCppSocket::setDatagramSize(unsigned int number_of_bytes)
+{
+	if (number_of_bytes <= datagram_header_size || number_of_bytes > max_datagram_size)
+	{
+		printf("Datagram size should be between %u and %u bytes\n", datagram_header_size + 1, max_datagram_size);
+		return;
+	}
+	this->datagram_size = number_of_bytes;
+}
+
+/**
+ * @brief A setter function for how long a read waits for the next complete
+ * frame with SOCK_DGRAM. readImage returns an empty Mat when it times out,
+ * other reads throw. Set it on the end that waits for replies (usually the
+ * client), so a lost frame skips an exchange instead of blocking both ends.
+ * @param milliseconds Timeout in milliseconds (0 waits forever)
+ */
+void EzCppSocket::setDatagramTimeout(unsigned int milliseconds)
+{
+	this->datagram_timeout = milliseconds;
+}
+
+/**
+ * @brief A getter function for the number of frames that were skipped with
+ * SOCK_DGRAM because datagrams were lost, arrived late or a newer frame was
+ * completed first.
+ * @return unsigned long Number of dropped frames
+ */
+unsigned long EzCppSocket::getDroppedFrames()
+{
+	return this->dropped_frame_count;
+}
+
+/**
+ * @brief A setter function for the number of threads that run the serverLoop
+ * callback of a multi-client server (client_connection_count > 1).
+ * With more than one thread, different connections are served in parallel, so
+ * the callback must not share unprotected state between connections.
+ * A single connection is never served by two threads at once.
+ * @param thread_count Number of worker threads (0 uses one per core)
+ */
+void EzCppSocket::setWorkerThreads(unsigned int thread_count)
+{
+	if (thread_count == 0)
+		thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+	this->worker_threads = thread_count;
+}
+
+/**
+ * @brief A getter function for the number of serverLoop worker threads
+ * @return unsigned int Number of worker threads
+ */
+unsigned int EzCppSocket::getWorkerThreads()
+{
+	return this->worker_threads;
+}
+
+/**
+ * @brief Reject a size announced by the peer if it is larger than the maximum
+ * message size, before anything is allocated for it
+ * @param size Number of bytes announced by the peer
+ */
+void EzCppSocket::checkMessageSize(size_t size)
+{
+	if (size > this->max_message_size)
+	{
+		std::cout << "Received message size " << size << " is larger than the maximum message size "
+				  << this->max_message_size << "! Use setMaxMessageSize to allow larger messages.\n";
+		throw std::runtime_error("Message size check in received message failed");
+	}
+}
+
+/**
+ * @brief Make sure the receive buffer can hold size bytes plus a terminating
+ * null byte. The buffer only ever grows, so no allocation happens once it has
+ * reached the size of the largest message in the stream.
+ * @param size Number of bytes about to be read
+ * @return uchar* Start of the receive buffer
+ */
+uchar *EzCppSocket::reserveReceiveBuffer(size_t size)
+{
+	this->checkMessageSize(size);
+	if (this->recv_buffer.size() < size + 1)
+		this->recv_buffer.resize(size + 1);
+	this->recv_buffer[size] = 0;
+	return this->recv_buffer.data();
+}
+
+/**
+ * @brief Read a complete message into the receive buffer and check its tokens
+ * in place. The returned pointer stays valid until the next read.
+ * @param expected_type Type of message the caller wants to read
+ * @param payload_size Set to the size of the payload (without tokens)
+ * @return const uchar* Start of the payload (null terminated)
+ */
+const uchar *EzCppSocket::readPayload(MessageType expected_type, size_t &payload_size)
+{
+	return this->readMessage(this->readHeader(expected_type), payload_size);
+}
+
+/**
+ * @brief Read a message whose header was already read into the receive buffer
+ * and check its tokens in place (see readPayload).
+ * @param message_size Size of the message including tokens
+ * @param payload_size Set to the size of the payload (without tokens)
+ * @return const uchar* Start of the payload (null terminated)
+ */
+const uchar *EzCppSocket::readMessage(size_t message_size, size_t &payload_size)
+{
+	uchar *buffer = this->reserveReceiveBuffer(message_size);
+	this->readFully(buffer, message_size);
+	return this->extractPayload(buffer, message_size, payload_size);
+}
+
+/**
+ * @brief Check the tokens of a message read into the receive buffer and null
+ * terminate its payload.
+ * @param buffer Start of the message (receive buffer)
+ * @param message_size Size of the message including tokens
+ * @param payload_size Set to the size of the payload (without tokens)
+ * @return const uchar* Start of the payload (null terminated)
+ */
+const uchar *EzCppSocket::extractPayload(uchar *buffer, size_t message_size, size_t &payload_size)
+{
+	const size_t token_size = this->tokens.first.length() + this->tokens.second.length();
+	if (!this->checkTokens(buffer, message_size))
+	{
+		payload_size = 0;
+		return buffer + message_size;
+	}
+
+	payload_size = message_size - token_size;
+	buffer[this->tokens.first.length() + payload_size] = 0;
+	return buffer + this->tokens.first.length();
+}
+
+/**
+ * @brief Read the header that precedes every message and return the size of the
+ * payload that follows it.
+ * @param expected_type Type of message the caller wants to read
+ * @return unsigned int Size of the (token included) payload in bytes
+ */
+unsigned int EzCppSocket::readHeader(MessageType expected_type)
+{
+	if (!this->binary_framing)
+		return this->readInt();
+
+	uchar header[frame_header_size] = {0};
+	this->readFully(header, frame_header_size);
+	return this->inflateMessage(this->parseHeader(header, expected_type));
+}
+
+/**
+ * @brief Size of the header that precedes every message
+ * @return size_t Header size in bytes
+ */
+size_t EzCppSocket::headerSize()
+{
+	if (this->binary_framing)
+		return frame_header_size;
+	return this->tokens.first.length() + 16 + this->tokens.second.length();
+}
+
+/**
+ * @brief Parse a header of headerSize() bytes (see readHeader). The flags and
+ * image codec of a binary frame header are kept in received_flags/received_codec.
+ * @param header Received header (modified when text framing is used)
+ * @param expected_type Type of message the caller wants to read
+ * @return unsigned int Size of the (token included) payload in bytes
+ */
+unsigned int EzCppSocket::parseHeader(uchar *header, MessageType expected_type)
+{
+	if (!this->binary_framing)
+	{
+		this->received_flags = 0;
+		this->received_codec = CODEC_JPEG;
+		const size_t header_size = this->headerSize();
+		this->checkTokens(header, header_size);
+		header[header_size - this->tokens.second.length()] = 0;
+
+		const char *number = reinterpret_cast<const char *>(header) + this->tokens.first.length();
+		char *number_end;
+		const long payload_size = strtol(number, &number_end, 10);
+		if (number_end == number || payload_size < 0)
+			throw std::invalid_argument("Received an invalid message size");
+
+		if (this->debug)
+			std::cout << "Received header, payload size : " << payload_size << "\n";
+		return payload_size;
+	}
+
+	unsigned int payload_size = getUint32(header);
+	this->received_flags = header[5];
+	this->received_codec = header[6];
+
+	if (this->debug)
+		std::cout << "Received frame header, type : " << int(header[4]) << " payload size : " << payload_size << "\n";
+
+	if (header[4] != expected_type)
+		std::cout << "Received message of type " << int(header[4]) << " while expecting type " << int(expected_type) << "!"
+				  << " Please check if the right kind of data is being sent/received or that"
+				  << " binary framing is set on both server and client ends...\n";
+
+	return payload_size;
+}
+
+/**
+ * @brief Read exactly size bytes from the socket, retrying on short reads
+ * and on calls interrupted by signals.
+ * @param buffer Buffer to read into (at least size bytes)
+ * @param size Number of bytes to read
+ */
+void EzCppSocket::readFully(void *buffer, size_t size)
+{
+	uchar *ptr = static_cast<uchar *>(buffer);
+	size_t received = 0;
+	while (received < size)
+	{
+		ssize_t valread = this->receiveSome(ptr + received, size - received, 0);
+		if (valread > 0)
+			received += valread;
+		else if (valread < 0 && errno == EINTR)
+			continue;
+		else
+		{
+			if (valread == 0)
+				printf("\nConnection closed by peer while reading.\n");
+			else
+				perror("Read failed");
+			throw std::runtime_error("Reading from socket failed");
+		}
+	}
+}
+
+/**
+ * @brief recv for the read paths. The rest of a decompressed message is read
+ * first (see inflateMessage). With SOCK_SEQPACKET, whole records are
+ * received (a partially read record would lose its remainder) and the bytes
+ * that were not asked for are kept for the next call.
+ * @param buffer Buffer to read into
+ * @param size Maximum number of bytes to read
+ * @param flags recv flags
+ * @return ssize_t Bytes read, 0 when the peer closed, -1 on error (errno set)
+ */
+ssize_t EzCppSocket::receiveSome(uchar *buffer, size_t size, int flags)
+{
+	if (this->inflate_begin < this->inflate_end)
+	{
+		const size_t count = std::min(size, this->inflate_end - this->inflate_begin);
+		memcpy(buffer, this->inflate_buffer.data() + this->inflate_begin, count);
+		this->inflate_begin += count;
+		return count;
+	}
+
+	if (this->record_begin < this->record_end)
+	{
+		const size_t count = std::min(size, this->record_end - this->record_begin);
+		memcpy(buffer, this->record_buffer.data() + this->record_begin, count);
+		this->record_begin += count;
+		return count;
+	}
+
+	if (this->socket_type == SOCK_DGRAM)
+	{
+		// Whole messages are reassembled into the record buffer
+		if (!this->receiveDatagramFrame())
+		{
+			errno = ETIMEDOUT;
+			return -1;
+		}
+		return this->receiveSome(buffer, size, flags);
+	}
+
+	if (this->socket_type != SOCK_SEQPACKET)
+		return recv(this->sock, buffer, size, flags);
+
+	// Large reads take records directly, smaller ones go through the record buffer
+	if (size >= seqpacket_record_size)
+		return this->receiveRecord(buffer, flags);
+
+	if (this->record_buffer.size() < seqpacket_record_size)
+		this->record_buffer.resize(seqpacket_record_size);
+	ssize_t valread = this->receiveRecord(this->record_buffer.data(), flags);
+	if (valread <= 0)
+		return valread;
+	this->record_begin = 0;
+	this->record_end = valread;
+	return this->receiveSome(buffer, size, flags);
+}
+
+/**
+ * @brief Receive one SOCK_SEQPACKET record of at most seqpacket_record_size bytes
+ * @param buffer Buffer to read into (at least seqpacket_record_size bytes)
+ * @param flags recv flags
+ * @return ssize_t Bytes read, 0 when the peer closed, -1 on error (errno set)
+ */
+ssize_t EzCppSocket::receiveRecord(uchar *buffer, int flags)
+{
+	ssize_t valread = recv(this->sock, buffer, seqpacket_record_size, flags | MSG_TRUNC);
+	if (valread > (ssize_t)seqpacket_record_size)
+	{
+		printf("\nReceived a record larger than %zu bytes, is the peer using SOCK_SEQPACKET records of a different size?\n",
+			   seqpacket_record_size);
+		errno = EMSGSIZE;
+		return -1;
+	}
+	return valread;
+}
+
+/**
+ * @brief Whether bytes of the next message were already received into the
+ * record buffer (SOCK_SEQPACKET, SOCK_DGRAM) or the inflate buffer (compressed
+ * messages), so waiting on the socket would miss them.
+ * @return true Buffered bytes are waiting to be read
+ */
+bool EzCppSocket::hasBufferedData()
+{
+	return this->inflate_begin < this->inflate_end || this->record_begin < this->record_end;
+}
+
+/**
+ * @brief Enlarge the socket buffers of a SOCK_DGRAM socket. A frame arrives as
+ * a burst of datagrams, and the kernel drops whatever does not fit in the
+ * receive buffer (the sizes are capped by net.core.rmem_max/wmem_max).
+ */
+void EzCppSocket::configureDatagramSocket()
+{
+	int buffer_size = 4 << 20;
+	setsockopt(this->sock, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+	setsockopt(this->sock, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+}
+
+/**
+ * @brief Wait for the first datagram of a client (SOCK_DGRAM server) and
+ * connect the socket to its address, so reads only accept that client and
+ * sends go to it. The datagram is left in the socket for the first read.
+ */
+void EzCppSocket::waitForDatagramPeer()
+{
+	printf("Waiting for a client datagram ...\n");
+	struct sockaddr_storage client_addr;
+	socklen_t addrlen = sizeof(client_addr);
+	uchar first_byte;
+	while (recvfrom(this->sock, &first_byte, 1, MSG_PEEK, (struct sockaddr *)&client_addr, &addrlen) < 0)
+	{
+		if (errno == EINTR)
+			continue;
+		perror("recvfrom");
+		exit(EXIT_FAILURE);
+	}
+	if (connect(this->sock, (struct sockaddr *)&client_addr, addrlen) < 0)
+	{
+		perror("connect");
+		exit(EXIT_FAILURE);
+	}
+	this->printPeerAddress(client_addr);
+	printf("Connection established ...\n");
+}
+
+/**
+ * @brief Send a complete message as one frame of datagrams (SOCK_DGRAM).
+ * Each datagram carries the frame id and the offset of its fragment, so the
+ * receiver can reassemble the frame in any order and tell when it is complete.
+ * The datagrams are sent in batches with sendmmsg, or one at a time with
+ * sleep_between_packets in between.
+ * @param iov Buffers that make up the message
+ * @param iovcnt Number of buffers
+ */
+void EzCppSocket::sendDatagrams(const struct iovec *iov, size_t iovcnt)
+{
+	size_t frame_size = 0;
+	for (size_t i = 0; i < iovcnt; i++)
+		frame_size += iov[i].iov_len;
+
+	const size_t fragment_size = this->datagram_size - datagram_header_size;
+	const size_t fragment_count = std::max<size_t>((frame_size + fragment_size - 1) / fragment_size, 1);
+	if (frame_size > UINT32_MAX || fragment_count > UINT16_MAX)
+	{
+		std::cout << "Message of " << frame_size << " bytes does not fit in " << UINT16_MAX << " datagrams of "
+				  << this->datagram_size << " bytes! Use setDatagramSize to send larger datagrams.\n";
+		throw std::runtime_error("Message is too large for datagram mode");
+	}
+	const uint32_t frame_id = this->next_datagram_frame++;
+
+	std::vector<uchar> headers(fragment_count * datagram_header_size);
+	std::vector<struct iovec> parts;
+	parts.reserve(fragment_count + iovcnt);
+	std::vector<size_t> first_part(fragment_count + 1);
+
+	// Slice the message buffers into fragments, each behind its own header
+	size_t buffer_index = 0, buffer_offset = 0;
+	for (size_t fragment = 0; fragment < fragment_count; fragment++)
+	{
+		const size_t fragment_offset = fragment * fragment_size;
+		uchar *header = &headers[fragment * datagram_header_size];
+		putUint32(header, frame_id);
+		putUint32(header + 4, frame_size);
+		putUint32(header + 8, fragment_offset);
+		header[12] = fragment & 0xff;
+		header[13] = fragment >> 8;
+		header[14] = fragment_count & 0xff;
+		header[15] = fragment_count >> 8;
+
+		first_part[fragment] = parts.size();
+		parts.push_back({header, datagram_header_size});
+		size_t remaining = std::min(fragment_size, frame_size - fragment_offset);
+		while (remaining > 0)
+		{
+			const size_t count = std::min(remaining, iov[buffer_index].iov_len - buffer_offset);
+			if (count > 0)
+				parts.push_back({static_cast<uchar *>(iov[buffer_index].iov_base) + buffer_offset, count});
+			remaining -= count;
+			buffer_offset += count;
+			if (buffer_offset == iov[buffer_index].iov_len)
+			{
+				buffer_index++;
+				buffer_offset = 0;
+			}
+		}
+	}
+	first_part[fragment_count] = parts.size();
+
+	std::vector<struct mmsghdr> datagrams(fragment_count);
+	for (size_t fragment = 0; fragment < fragment_count; fragment++)
+	{
+		datagrams[fragment] = {};
+		datagrams[fragment].msg_hdr.msg_iov = &parts[first_part[fragment]];
+		datagrams[fragment].msg_hdr.msg_iovlen = first_part[fragment + 1] - first_part[fragment];
+	}
+
+	if (this->debug)
+		std::cout << "Sending frame " << frame_id << " of size " << frame_size << " in " << fragment_count << " datagrams\n";
+
+	size_t sent = 0;
+	while (sent < fragment_count)
+	{
+		size_t batch = this->sleep_between_packets > 0 ? 1 : std::min<size_t>(fragment_count - sent, UIO_MAXIOV);
+		if (this->rate_limit > 0)
+			batch = std::min(batch, std::max<size_t>(this->rate_burst / this->datagram_size, 1));
+		int valsent = sendmmsg(this->sock, &datagrams[sent], batch, MSG_NOSIGNAL);
+		if (valsent < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			if (errno == ECONNREFUSED)
+			{
+				// Nobody is listening (yet), the frame is lost like any other datagram
+				if (this->debug)
+					printf("Peer refused frame %u\n", frame_id);
+				return;
+			}
+			perror("Send failed");
+			throw std::runtime_error("Writing to socket failed");
+		}
+		size_t bytes_sent = 0;
+		for (int i = 0; i < valsent; i++)
+			bytes_sent += datagrams[sent + i].msg_len;
+		sent += valsent;
+		this->paceSend(bytes_sent);
+
+		if (this->sleep_between_packets > 0 && sent < fragment_count)
+			usleep(this->sleep_between_packets);
+	}
+}
+
+/**
+ * @brief Receive datagrams until a frame is complete and move it into the
+ * record buffer, where the read functions take the message from (SOCK_DGRAM).
+ * Frames are never delivered out of order: datagrams of frames older than the
+ * last delivered one are ignored, and frames still incomplete when a newer
+ * frame completes are dropped, so a lost datagram costs one frame instead of
+ * stalling the stream.
+ * @return true A frame was moved into the record buffer
+ * @return false datagram_timeout passed without a complete frame
+ */
+bool EzCppSocket::receiveDatagramFrame()
+{
+	if (this->datagram_buffer.size() < max_datagram_size)
+		this->datagram_buffer.resize(max_datagram_size);
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(this->datagram_timeout);
+
+	while (true)
+	{
+		if (this->datagram_timeout > 0)
+		{
+			const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+			struct pollfd socket_poll = {this->sock, POLLIN, 0};
+			int ready = remaining.count() > 0 ? poll(&socket_poll, 1, remaining.count()) : 0;
+			if (ready < 0 && errno == EINTR)
+				continue;
+			if (ready == 0)
+			{
+				if (this->debug)
+					printf("No complete frame within %u ms\n", this->datagram_timeout);
+				return false;
+			}
+		}
+
+		ssize_t valread = recv(this->sock, this->datagram_buffer.data(), max_datagram_size, 0);
+		if (valread < 0)
+		{
+			// ECONNREFUSED reports a datagram we sent before the peer was listening
+			if (errno == EINTR || errno == ECONNREFUSED)
+				continue;
+			perror("Read failed");
+			throw std::runtime_error("Reading from socket failed");
+		}
+		if (valread < (ssize_t)datagram_header_size)
+			continue;
+
+		const uchar *header = this->datagram_buffer.data();
+		const uint32_t id = getUint32(header);
+		const size_t frame_size = getUint32(header + 4);
+		const size_t fragment_offset = getUint32(header + 8);
+		const size_t fragment_index = header[12] | (header[13] << 8);
+		const size_t fragment_count = header[14] | (header[15] << 8);
+		const size_t fragment_size = valread - datagram_header_size;
+
+		// Skip frames that are not newer than the last one delivered
+		if (this->datagram_frame_delivered && (int32_t)(id - this->last_datagram_frame) <= 0)
+			continue;
+		if (fragment_index >= fragment_count || fragment_offset + fragment_size > frame_size ||
+			frame_size > this->max_message_size)
+		{
+			if (this->debug)
+				printf("Ignoring malformed datagram of frame %u\n", id);
+			continue;
+		}
+
+		EzDatagramFrame *frame = this->datagramFrame(id, frame_size, fragment_count);
+		if (frame == nullptr || frame->received[fragment_index])
+			continue;
+		memcpy(frame->data.data() + fragment_offset, header + datagram_header_size, fragment_size);
+		frame->received[fragment_index] = true;
+		frame->bytes_received += fragment_size;
+		if (--frame->fragments_left > 0)
+			continue;
+		if (frame->bytes_received != frame_size)
+		{
+			// The fragments overlap or leave gaps, so the frame cannot be trusted
+			if (this->debug)
+				printf("Dropping frame %u, its fragments do not add up to its size\n", id);
+			frame->active = false;
+			continue;
+		}
+
+		// Frame complete: frames that were skipped since the last one are dropped
+		if (this->datagram_frame_delivered)
+			this->dropped_frame_count += id - this->last_datagram_frame - 1;
+		this->last_datagram_frame = id;
+		this->datagram_frame_delivered = true;
+		for (auto &pending : this->datagram_frames)
+			if (pending.active && (int32_t)(pending.id - id) <= 0)
+				pending.active = false;
+
+		// Hand the frame over, its old buffer is reused for the next frame
+		std::swap(this->record_buffer, frame->data);
+		this->record_begin = 0;
+		this->record_end = frame_size;
+		if (this->debug)
+			std::cout << "Received frame " << id << " of size " << frame_size << "\n";
+		return true;
+	}
+}
+
+/**
+ * @brief Find the reassembly slot of a frame, or start reassembling it in a
+ * free slot (taking the slot of the oldest frame if all are in use).
+ * @param id Frame id
+ * @param frame_size Size of the frame in bytes
+ * @param fragment_count Number of datagrams the frame was split into
+ * @return EzDatagramFrame* Slot of the frame, nullptr if the datagram is to be ignored
+ */
+EzDatagramFrame *EzCppSocket::datagramFrame(uint32_t id, size_t frame_size, size_t fragment_count)
+{
+	if (this->datagram_frames.empty())
+		this->datagram_frames.resize(datagram_reassembly_slots);
+
+	EzDatagramFrame *slot = nullptr; // A free slot, else the one of the oldest frame
+	for (auto &frame : this->datagram_frames)
+	{
+		if (frame.active && frame.id == id)
+		{
+			// Datagrams of one frame must agree on its layout
+			if (frame.data.size() != frame_size || frame.received.size() != fragment_count)
+				return nullptr;
+			return &frame;
+		}
+		if (!frame.active)
+		{
+			if (slot == nullptr || slot->active)
+				slot = &frame;
+		}
+		else if (slot == nullptr || (slot->active && (int32_t)(frame.id - slot->id) < 0))
+			slot = &frame;
+	}
+
+	// All slots are busy with newer frames
+	if (slot->active && (int32_t)(id - slot->id) < 0)
+		return nullptr;
+
+	slot->active = true;
+	slot->id = id;
+	slot->data.resize(frame_size);
+	slot->received.assign(fragment_count, false);
+	slot->fragments_left = fragment_count;
+	slot->bytes_received = 0;
+	return slot;
+}
+
+/**
+ * @brief Wait until size bytes are available on the socket and copy them
+ * without removing them from the socket.
+ * @param buffer Buffer to copy into (at least size bytes)
+ * @param size Number of bytes to peek at
+ */
+void EzCppSocket::peekFully(void *buffer, size_t size)
+{
+	if (this->socket_type == SOCK_DGRAM)
+	{
+		// Messages are never split across frames, so the next frame holds the whole message
+		if (!this->hasBufferedData() && !this->receiveDatagramFrame())
+			throw std::runtime_error("Timed out waiting for a frame");
+		if (this->record_end - this->record_begin < size)
+			throw std::runtime_error("Received frame is smaller than the message header");
+		memcpy(buffer, this->record_buffer.data() + this->record_begin, size);
+		return;
+	}
+
+	if (this->socket_type == SOCK_SEQPACKET)
+	{
+		// Peeking only sees the first record, so stage as many records as needed
+		while (this->record_end - this->record_begin < size)
+		{
+			memmove(this->record_buffer.data(), this->record_buffer.data() + this->record_begin,
+					this->record_end - this->record_begin);
+			this->record_end -= this->record_begin;
+			this->record_begin = 0;
+			this->record_buffer.resize(std::max(this->record_buffer.size(), this->record_end + seqpacket_record_size));
+
+			ssize_t valread = this->receiveRecord(this->record_buffer.data() + this->record_end, 0);
+			if (valread > 0)
+				this->record_end += valread;
+			else if (valread < 0 && errno == EINTR)
+				continue;
+			else
+			{
+				if (valread == 0)
+					printf("\nConnection closed by peer while reading.\n");
+				else
+					perror("Read failed");
+				throw std::runtime_error("Reading from socket failed");
+			}
+		}
+		memcpy(buffer, this->record_buffer.data() + this->record_begin, size);
+		return;
+	}
+
+	while (true)
+	{
+		ssize_t valread = recv(this->sock, buffer, size, MSG_PEEK | MSG_WAITALL);
+		if (valread == (ssize_t)size)
+			return;
+		else if (valread > 0 || (valread < 0 && errno == EINTR))
+			continue;
+		else
+		{
+			if (valread == 0)
+				printf("\nConnection closed by peer while reading.\n");
+			else
+				perror("Read failed");
+			throw std::runtime_error("Reading from socket failed");
+		}
+	}
+}
+
+/**
+ * @brief Tell the peer's serverLoop that the client loop has stopped.
+ * With binary framing this is a MSG_CONTROL message, else a header carrying
+ * loop_stop_marker in place of the 16 digit size.
+ */
+void EzCppSocket::sendLoopStop()
+{
+	if (this->binary_framing)
+	{
+		uchar code = CONTROL_LOOP_STOP;
+		this->sendFrame(MSG_CONTROL, {{&code, 1}});
+		return;
+	}
+
+	std::string stop_message = this->tokens.first + loop_stop_marker + this->tokens.second;
+	this->writeFully(stop_message.data(), stop_message.length());
+}
+
+/**
+ * @brief Wait for the next message and consume it if it is the client's loop
+ * stop message. Any other message is left untouched for the next read.
+ * @return true The client has stopped its loop
+ * @return false The next message is regular data
+ */
+bool EzCppSocket::readLoopStop()
+{
+	if (this->binary_framing)
+	{
+		uchar header[frame_header_size];
+		this->peekFully(header, frame_header_size);
+		if (header[4] != MSG_CONTROL)
+			return false;
+
+		size_t payload_size;
+		const uchar *payload = this->readPayload(MSG_CONTROL, payload_size);
+		return payload_size == 1 && payload[0] == CONTROL_LOOP_STOP;
+	}
+
+	const size_t marker_size = sizeof(loop_stop_marker) - 1;
+	const size_t peek_size = this->tokens.first.length() + marker_size;
+	uchar *header = this->reserveReceiveBuffer(peek_size + this->tokens.second.length());
+	this->peekFully(header, peek_size);
+	if (memcmp(header + this->tokens.first.length(), loop_stop_marker, marker_size) != 0)
+		return false;
+
+	this->readFully(header, peek_size + this->tokens.second.length());
+	return true;
+}
+
+/**
+ * @brief Write all the given buffers to the socket with as few sendmsg calls
+ * as possible, retrying on partial sends and on calls interrupted by signals.
+ * If sleep_between_packets is set, at most packet_size bytes are written per
+ * call with the delay in between, and with setRateLimit the calls are paced
+ * by the token bucket.
+ * Note: The iovec array is modified while sending.
+ * @param iov Buffers to be sent
+ * @param iovcnt Number of buffers
+ */
+void EzCppSocket::writeVectorFully(struct iovec *iov, size_t iovcnt)
+{
+	if (this->socket_type == SOCK_DGRAM)
+	{
+		this->sendDatagrams(iov, iovcnt);
+		return;
+	}
+
+	while (iovcnt > 0)
+	{
+		// Skip buffers that are already sent (or empty)
+		if (iov->iov_len == 0)
+		{
+			iov++;
+			iovcnt--;
+			continue;
+		}
+
+		size_t clipped_index, clipped_len;
+		size_t count = this->clipToPacket(iov, std::min<size_t>(iovcnt, IOV_MAX), clipped_index, clipped_len);
+
+		struct msghdr msg = {};
+		msg.msg_iov = iov;
+		msg.msg_iovlen = count;
+		ssize_t valsent = sendmsg(this->sock, &msg, MSG_NOSIGNAL);
+
+		if (clipped_index < count)
+			iov[clipped_index].iov_len = clipped_len;
+
+		if (valsent < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			perror("Send failed");
+			throw std::runtime_error("Writing to socket failed");
+		}
+		this->paceSend(valsent);
+
+		// Advance past the bytes that were sent
+		size_t remaining = valsent;
+		while (remaining > 0)
+		{
+			if (remaining >= iov->iov_len)
+			{
+				remaining -= iov->iov_len;
+				iov->iov_len = 0;
+				iov++;
+				iovcnt--;
+			}
+			else
+			{
+				iov->iov_base = static_cast<uchar *>(iov->iov_base) + remaining;
+				iov->iov_len -= remaining;
+				remaining = 0;
+			}
+		}
+
+		if (this->sleep_between_packets > 0 && iovcnt > 0)
+			usleep(this->sleep_between_packets);
+	}
+}
+
+/**
+ * @brief Limit a sendmsg call to a single packet: packet_size bytes when
+ * sleep_between_packets is set, and one record of at most
+ * seqpacket_record_size bytes for SOCK_SEQPACKET. The buffer that crosses the
+ * limit is shortened, restore it with clipped_index/clipped_len after sending.
+ * @param iov Buffers to be sent
+ * @param count Number of buffers
+ * @param clipped_index Set to the index of the shortened buffer (count if none)
+ * @param clipped_len Set to the original length of the shortened buffer
+ * @return size_t Number of buffers to pass to sendmsg
+ */
+size_t EzCppSocket::clipToPacket(struct iovec *iov, size_t count, size_t &clipped_index, size_t &clipped_len)
+{
+	size_t limit = 0;
+	if (this->sleep_between_packets > 0)
+		limit = this->packet_size;
+	if (this->rate_limit > 0 && (limit == 0 || limit > this->rate_burst))
+		limit = this->rate_burst;
+	if (this->socket_type == SOCK_SEQPACKET && (limit == 0 || limit > seqpacket_record_size))
+		limit = seqpacket_record_size;
+
+	clipped_index = count;
+	clipped_len = 0;
+	if (limit == 0)
+		return count;
+
+	size_t total = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (total + iov[i].iov_len >= limit)
+		{
+			clipped_index = i;
+			clipped_len = iov[i].iov_len;
+			iov[i].iov_len = limit - total;
+			return i + 1;
+		}
+		total += iov[i].iov_len;
+	}
+	return count;
+}
+
+/**
+ * @brief Write exactly size bytes to the socket, retrying on partial sends
+ * and on calls interrupted by signals.
+ * @param buffer Buffer to be sent
+ * @param size Number of bytes to send
+ */
+void EzCppSocket::writeFully(const void *buffer, size_t size)
+{
+	if (this->socket_type == SOCK_DGRAM)
+	{
+		struct iovec message = {const_cast<void *>(buffer), size};
+		this->sendDatagrams(&message, 1);
+		return;
+	}
+
+	const uchar *ptr = static_cast<const uchar *>(buffer);
+	size_t sent = 0;
+	while (sent < size)
+	{
+		const size_t chunk = this->rate_limit > 0 ? std::min(size - sent, this->rate_burst) : size - sent;
+		ssize_t valsent = send(this->sock, ptr + sent, chunk, MSG_NOSIGNAL);
+		if (valsent > 0)
+		{
+			sent += valsent;
+			this->paceSend(valsent);
+		}
+		else if (valsent < 0 && errno == EINTR)
+			continue;
+		else
+		{
+			perror("Send failed");
+			throw std::runtime_error("Writing to socket failed");
+		}
+	}
+}
+
+// Incoming
+
+/**
+ * @brief Read bool value received on port
+ * 
+ * @return std::pair<bool, bool> Receive (received_flag, received_bool)
+ */
+std::pair<bool, bool> EzCppSocket::readBool()
+{
+	bool ret = true, value = false;
+	try
+	{
+		std::string received = this->readString();
+		if (!received.compare("true") || !received.compare("1")) // If strings match, compare gives 0
+			value = true;
+		else if (!received.compare("false") || !received.compare("0"))
+			;
+		else
+		{
+			ret = false;
+			throw(received);
+		}
+	}
+	catch (std::string message)
+	{
+		printf("\n Message received: %s", message.c_str());
+		printf("\n Unable to collect proper boolean information from message.\n");
+	}
+	return std::pair<bool, bool>(ret, value);
+}
+
+/**
+ * @brief Read message received on port
+ * 
+ * @return std::string  Received buffer
+ */
+std::string EzCppSocket::readString()
+{
+	size_t payload_size;
+	const uchar *payload = this->readPayload(MSG_STRING, payload_size);
+	std::string str(payload, payload + payload_size);
+
+	if (this->debug)
+		printf("Final string : %s\n", str.c_str());
+
+	return str;
+}
+
+/**
+ * @brief Read integer value received on port
+ * 
+ * @param buffer_size Size of buffer to be read (in bytes)
+ * @return int Received integer
+ */
+int EzCppSocket::readInt(const int buffer_size)
+{
+	if (this->binary_framing)
+	{
+		size_t payload_size;
+		const uchar *payload = this->readPayload(MSG_INT, payload_size);
+		const int32_t value = (payload_size >= 4) ? (int32_t)getUint32(payload) : 0;
+
+		if (this->debug)
+			printf("Converted int : %i\n", value);
+
+		return value;
+	}
+
+	const size_t token_compensated_buffer_size = this->tokens.first.length() + buffer_size + this->tokens.second.length();
+	uchar *buffer = this->reserveReceiveBuffer(token_compensated_buffer_size);
+	this->readFully(buffer, token_compensated_buffer_size);
+	this->checkTokens(buffer, token_compensated_buffer_size);
+	buffer[token_compensated_buffer_size - this->tokens.second.length()] = 0;
+
+	const char *number = reinterpret_cast<const char *>(buffer) + this->tokens.first.length();
+	char *number_end;
+	const long value = strtol(number, &number_end, 10);
+	if (number_end == number)
+		throw std::invalid_argument("readInt received an invalid integer");
+
+	if (this->debug)
+	{
+		printf("readInt buffer received: '%s' \n", number);
+		printf("Converted int : %li\n", value);
+	}
+
+	return value;
+}
+
+/**
+ * @brief Read float value received on port
+ * 
+ * @param buffer_size Size of buffer to be read (in bytes)
+ * @return int Received float
+ */
+float EzCppSocket::readFloat(const int buffer_size)
+{
+	if (this->binary_framing)
+	{
+		size_t payload_size;
+		const uchar *payload = this->readPayload(MSG_FLOAT, payload_size);
+		const uint32_t raw = (payload_size >= 4) ? getUint32(payload) : 0;
+		float value;
+		memcpy(&value, &raw, sizeof(value));
+
+		if (this->debug)
+			printf("Converted float : %f\n", value);
+
+		return value;
+	}
+
+	const size_t token_compensated_buffer_size = this->tokens.first.length() + buffer_size + this->tokens.second.length();
+	uchar *buffer = this->reserveReceiveBuffer(token_compensated_buffer_size);
+	this->readFully(buffer, token_compensated_buffer_size);
+	this->checkTokens(buffer, token_compensated_buffer_size);
+	buffer[token_compensated_buffer_size - this->tokens.second.length()] = 0;
+
+	const char *number = reinterpret_cast<const char *>(buffer) + this->tokens.first.length();
+	char *number_end;
+	const float value = strtof(number, &number_end);
+	if (number_end == number)
+		throw std::invalid_argument("readFloat received an invalid float");
+
+	if (this->debug)
+	{
+		printf("readFloat buffer received: %s\n", number);
+		printf("Converted float : %f\n", value);
+	}
+
+	return value;
+}
+
+/**
+ * @brief Read a list of integer values
+ * 
+ * @return std::vector<int> Integer List received
+ */
+std::vector<int> EzCppSocket::readIntList()
+{
+	if (this->binary_lists)
+	{
+		std::vector<int> v(this->readListHeader(MSG_INT_LIST, DTYPE_INT32));
+		this->readFully(v.data(), v.size() * sizeof(int));
+		this->readToken(this->tokens.second, false);
+		return v;
+	}
+
+	size_t payload_size;
+	const char *str = reinterpret_cast<const char *>(this->readPayload(MSG_INT_LIST, payload_size)); // get message
+
+	// Parse the values between the [] characters in place
+	std::vector<int> v;
+	const char *ptr = (payload_size > 0) ? str + 1 : str;
+	char *ptr_end;
+	while (*ptr != ']' && *ptr != '\0')
+	{
+		v.push_back(strtol(ptr, &ptr_end, 10));
+		if (ptr_end == ptr)
+			break;
+		ptr = ptr_end;
+		while (*ptr == ',' || *ptr == ' ')
+			ptr++;
+	}
+
+	if (this->debug)
+	{
+		printf("readIntList buffer received: %s\n", str);
+		for (auto elem : v)
+		{
+			printf("%i ,", elem);
+		}
+		std::cout << "\n";
+	}
+
+	return v;
+}
+
+/**
+ * @brief Read a list of float values
+ * 
+ * @return std::vector<int> Float List received
+ */
+std::vector<float> EzCppSocket::readFloatList()
+{
+	if (this->binary_lists)
+	{
+		std::vector<float> v(this->readListHeader(MSG_FLOAT_LIST, DTYPE_FLOAT32));
+		this->readFully(v.data(), v.size() * sizeof(float));
+		this->readToken(this->tokens.second, false);
+		return v;
+	}
+
+	size_t payload_size;
+	const char *str = reinterpret_cast<const char *>(this->readPayload(MSG_FLOAT_LIST, payload_size)); // get message
+
+	// Parse the values between the [] characters in place
+	std::vector<float> v;
+	const char *ptr = (payload_size > 0) ? str + 1 : str;
+	char *ptr_end;
+	while (*ptr != ']' && *ptr != '\0')
+	{
+		v.push_back(strtof(ptr, &ptr_end));
+		if (ptr_end == ptr)
+			break;
+		ptr = ptr_end;
+		while (*ptr == ',' || *ptr == ' ')
+			ptr++;
+	}
+
+	if (this->debug)
+	{
+		printf("readFloatList buffer received: %s\n", str);
+		for (auto elem : v)
+		{
+			printf("%f ,", elem);
+		}
+		std::cout << "\n";
+	}
+	return v;
+}
+
+/**
+ * @brief Read an OpenCV Image. The encoded frame is read once into the
+ * receive buffer and decoded from there with the codec named in its header.
+ * With SOCK_DGRAM, an empty Mat is returned if no complete frame arrived
+ * within the datagram timeout (see setDatagramTimeout).
+ * Tiled images are decoded while they arrive if setStreamingImages is set.
+ * 
+ * @return cv::Mat Received Image
+ */
+cv::Mat EzCppSocket::readImage()
+{
+	// With SOCK_DGRAM, a frame that does not arrive in time is skipped
+	if (this->socket_type == SOCK_DGRAM && !this->hasBufferedData() && !this->receiveDatagramFrame())
+		return cv::Mat();
+
+	size_t payload_size;
+	cv::Mat frame;
+	if (this->streaming_images && this->binary_framing)
+		frame = this->readStreamingImage(payload_size);
+	else
+	{
+		const uchar *payload = this->readPayload(MSG_IMAGE, payload_size);
+		frame = this->decodeImage(payload, payload_size);
+	}
+
+	if (this->debug)
+	{
+		std::cout << "Received the frame of size : " << payload_size << "\n";
+		cv::imwrite("received.jpg", frame);
+	}
+	return frame;
+}
+
+/**
+ * @brief Read a batch of images sent with sendImages. The batch is read once
+ * into the receive buffer and its images are decoded in parallel on the tile pool.
+ * 
+ * @return std::vector<cv::Mat> Received images, in the order they were sent
+ */
+std::vector<cv::Mat> EzCppSocket::readImages()
+{
+	size_t payload_size;
+	const uchar *payload = this->readPayload(MSG_IMAGE_BATCH, payload_size);
+	std::vector<cv::Mat> images;
+	if (payload_size == 0)
+		return images;
+	if (payload_size < batch_header_size)
+		throw std::runtime_error("Image batch check in received message failed");
+	const size_t count = getUint32(payload);
+	if (payload_size < batch_header_size + count * batch_entry_size)
+		throw std::runtime_error("Image batch check in received message failed");
+
+	// Payload offset of each image (and the end of the last one)
+	std::vector<size_t> offsets(count + 1, batch_header_size + count * batch_entry_size);
+	for (size_t i = 0; i < count; i++)
+		offsets[i + 1] = offsets[i] + getUint32(payload + batch_header_size + i * batch_entry_size);
+	if (offsets[count] != payload_size)
+	{
+		std::cout << "Received image batch table does not match the size of the message received!\n";
+		throw std::runtime_error("Image batch check in received message failed");
+	}
+
+	images.resize(count);
+	std::atomic<bool> failed{false};
+	this->tilePool()->run(count, [&](size_t i) {
+		try
+		{
+			images[i] = this->decodeImage(payload + offsets[i], offsets[i + 1] - offsets[i]);
+		}
+		catch (const std::exception &e)
+		{
+			std::cout << "Decoding batch image failed : " << e.what() << "\n";
+			failed = true;
+		}
+	});
+	if (failed)
+		throw std::runtime_error("Decoding batch image failed");
+
+	if (this->debug)
+		std::cout << "Received a batch of " << count << " images, size : " << payload_size << "\n";
+	return images;
+}
+
+/**
+ * @brief Read a raw OpenCV Mat sent with sendMat. No image codec is involved,
+ * the pixel data is read straight into the returned Mat.
+ * If the peer sent it through shared memory (setSharedMemory), the returned Mat
+ * points into the shared slot instead and is only valid until the next readMat
+ * (clone it to keep it longer).
+ * 
+ * @return cv::Mat Received Mat
+ */
+cv::Mat EzCppSocket::readMat()
+{
+	this->releaseSharedSlot();
+
+	unsigned int payload_size;
+	if (this->binary_framing)
+	{
+		// The peer may send the Mat through its shared memory ring instead
+		uchar header[frame_header_size];
+		this->readFully(header, frame_header_size);
+		while (header[4] == MSG_SHM_ATTACH)
+		{
+			size_t attach_size;
+			const uchar *attach = this->readMessage(getUint32(header), attach_size);
+			this->attachSharedMemory(attach, attach_size);
+			this->readFully(header, frame_header_size);
+		}
+		if (header[4] == MSG_SHM_MAT)
+		{
+			size_t notification_size;
+			const uchar *notification = this->readMessage(getUint32(header), notification_size);
+			return this->readSharedMat(notification, notification_size);
+		}
+		payload_size = this->inflateMessage(this->parseHeader(header, MSG_MAT));
+	}
+	else
+		payload_size = this->readHeader(MSG_MAT);
+	const unsigned int token_size = this->tokens.first.length() + this->tokens.second.length();
+
+	this->readToken(this->tokens.first, true);
+	uchar mat_header[mat_header_size] = {0};
+	this->readFully(mat_header, mat_header_size);
+
+	const uint32_t rows = getUint32(mat_header);
+	const uint32_t cols = getUint32(mat_header + 4);
+	const uint32_t type = getUint32(mat_header + 8);
+	const uint32_t step = getUint32(mat_header + 12);
+
+	if (this->debug)
+		std::cout << "readMat rows : " << rows << " cols : " << cols << " type : " << type << " step : " << step << "\n";
+
+	cv::Mat frame;
+	if (!validMatHeader(rows, cols, type, step, this->max_message_size) ||
+		payload_size != token_size + mat_header_size + (size_t)rows * step)
+	{
+		std::cout << "Received Mat header does not match the size of the message received!\n";
+		throw std::runtime_error("Mat header check in received message failed");
+	}
+
+	if (rows > 0 && cols > 0)
+	{
+		frame.create(rows, cols, type);
+		const size_t row_size = cols * frame.elemSize();
+		if (step == row_size)
+			this->readFully(frame.data, (size_t)rows * step);
+		else
+		{
+			// Rows were sent with padding, drop it while reading
+			uchar *padding = this->reserveReceiveBuffer(step - row_size);
+			for (int row = 0; row < (int)rows; row++)
+			{
+				this->readFully(frame.ptr(row), row_size);
+				this->readFully(padding, step - row_size);
+			}
+		}
+	}
+
+	this->readToken(this->tokens.second, false);
+	return frame;
+}
+
+// Outgoing
+/**
+ * @brief Send bool value
+ * 
+ * @param data Bool value to be sent
+ */
+void EzCppSocket::sendBool(bool data)
+{
+	this->sendString(bool(data) ? "true" : "false");
+}
+
+/**
+ * @brief Send string
+ * 
+ * @param msg String to be sent
+ */
+void EzCppSocket::sendString(const std::string &msg)
+{
+	this->sendMessage(MSG_STRING, msg);
+}
+
+/**
+ * @brief Send a message of the given type along with its header
+ * 
+ * @param type Type of message being sent
+ * @param msg Message to be sent
+ */
+void EzCppSocket::sendMessage(MessageType type, const std::string &msg)
+{
+	if (this->debug)
+		std::cout << "Sending message : " << msg << "\n";
+
+	this->sendFrame(type, {{const_cast<char *>(msg.data()), msg.size()}});
+}
+
+/**
+ * @brief Send int
+ * 
+ * @param data Int to be sent
+ */
+void EzCppSocket::sendInt(int data)
+{
+	if (this->binary_framing)
+	{
+		std::string int_message(4, '\0');
+		putUint32(reinterpret_cast<uchar *>(&int_message[0]), (uint32_t)data);
+		this->sendMessage(MSG_INT, int_message);
+		return;
+	}
+
+	std::string int_str = std::to_string(data);
+	std::string int_message =
+		std::string(16 - int_str.length(), '0') + int_str;
+	this->insertTokens(int_message);
+
+	if (this->debug)
+	{
+		std::cout << "Message sent length : " << int_message.length() << "\n";
+		std::cout << "Sending message : " << int_message << "\n";
+	}
+
+	this->writeFully(int_message.c_str(), int_message.length());
+}
+
+/**
+ * @brief Send float
+ * 
+ * @param data Float value to be sent
+ */
+void EzCppSocket::sendFloat(float data)
+{
+	if (this->binary_framing)
+	{
+		uint32_t raw;
+		memcpy(&raw, &data, sizeof(raw));
+		std::string float_message(4, '\0');
+		putUint32(reinterpret_cast<uchar *>(&float_message[0]), raw);
+		this->sendMessage(MSG_FLOAT, float_message);
+		return;
+	}
+
+	std::string float_str = std::to_string(data);
+	std::string float_message =
+		std::string(16 - float_str.length(), '0') + float_str;
+	this->insertTokens(float_message);
+
+	if (this->debug)
+	{
+		std::cout << "Message sent length : " << float_message.length() << "\n";
+		std::cout << "Sending message : " << float_message << "\n";
+	}
+
+	this->writeFully(float_message.c_str(), float_message.length());
+}
+
+/**
+ * @brief Send vector of ints
+ * 
+ * @param data Vector of ints to be sent
+ */
+void EzCppSocket::sendIntList(const std::vector<int> &data)
+{
+	if (this->binary_lists)
+	{
+		this->sendList(MSG_INT_LIST, DTYPE_INT32, data.data(), data.size());
+		return;
+	}
+
+	std::string int_list;
+	int_list += "[";
+	for (auto val : data)
+		int_list.append(std::to_string(val) + ",");
+
+	// remove the extra comma and add a closing bracket
+	int_list.substr(0, int_list.length() - 2);
+	int_list += "]";
+	this->sendMessage(MSG_INT_LIST, int_list);
+}
+
+/**
+ * @brief Send vector of floats
+ * 
+ * @param data Vector of floats to be sent
+ */
+void EzCppSocket::sendFloatList(const std::vector<float> &data)
+{
+	if (this->binary_lists)
+	{
+		this->sendList(MSG_FLOAT_LIST, DTYPE_FLOAT32, data.data(), data.size());
+		return;
+	}
+
+	std::string float_list;
+	float_list += "[";
+	for (auto val : data)
+	{
+		float_list.append(std::to_string(val) + ",");
+	}
+	// remove the extra comma and add a closing bracket
+	float_list.substr(0, float_list.length() - 2);
+	float_list += "]";
+	this->sendMessage(MSG_FLOAT_LIST, float_list);
+}
+
+/**
+ * @brief Send Image. The image is encoded with the codec set by setImageCodec
+ * (JPEG by default) into a buffer that is kept by the socket and reused for
+ * every frame, and is sent straight from there (header and tokens are gathered
+ * around it by sendFrame).
+ * 
+ * @param img Image to be sent
+ */
+void EzCppSocket::sendImage(const cv::Mat &img)
+{
+	uchar mat_header[mat_header_size];
+	uint8_t flags;
+	std::vector<struct iovec> payload = this->encodeImage(img, mat_header, flags);
+
+	if (this->debug)
+	{
+		size_t image_size = 0;
+		for (auto &part : payload)
+			image_size += part.iov_len;
+		std::cout << "Total image buffer size:" << image_size << "\n";
+	}
+
+	this->sendFrame(MSG_IMAGE, payload, flags, this->image_codec);
+}
+
+/**
+ * @brief Send a batch of images as one message. The images are encoded in
+ * parallel on the tile pool with the codec set by setImageCodec (CODEC_RAW
+ * images are sent straight from the Mats), and sent after a table of their
+ * sizes, so the receiver gets the whole batch with readImages.
+ * Tiles and delta images (setImageTiles, setDeltaImages) do not apply to batches.
+ * 
+ * @param imgs Images to be sent (empty images are received as empty Mats)
+ */
+void EzCppSocket::sendImages(const std::vector<cv::Mat> &imgs)
+{
+	if (!this->binary_framing && (this->image_codec == CODEC_RAW || this->keep_channels))
+	{
+		std::cout << "Raw images and keep_channels need binary framing! Use setBinaryFraming on both ends.\n";
+		throw std::runtime_error("Image codec needs binary framing");
+	}
+	const size_t count = imgs.size();
+	this->batch_table.resize(batch_header_size + count * batch_entry_size);
+	putUint32(this->batch_table.data(), count);
+
+	std::vector<struct iovec> payload;
+	payload.push_back({this->batch_table.data(), this->batch_table.size()});
+	if (this->image_codec == CODEC_RAW)
+	{
+		this->batch_mat_headers.resize(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			size_t image_size = 0;
+			if (!imgs[i].empty())
+				for (auto &part : this->matPayload(imgs[i], this->batch_mat_headers[i].bytes))
+				{
+					payload.push_back(part);
+					image_size += part.iov_len;
+				}
+			putUint32(this->batch_table.data() + batch_header_size + i * batch_entry_size, image_size);
+		}
+	}
+	else
+	{
+		std::vector<int> params;
+		const char *extension = this->codecParams(params);
+		this->batch_buffers.resize(count);
+		std::atomic<bool> failed{false};
+		this->tilePool()->run(count, [&](size_t i) {
+			this->batch_buffers[i].clear();
+			try
+			{
+				if (!imgs[i].empty())
+					cv::imencode(extension, imgs[i], this->batch_buffers[i], params);
+			}
+			catch (const std::exception &e)
+			{
+				std::cout << "Encoding batch image failed : " << e.what() << "\n";
+				failed = true;
+			}
+		});
+		if (failed)
+			throw std::runtime_error("Encoding batch image failed");
+		for (size_t i = 0; i < count; i++)
+		{
+			putUint32(this->batch_table.data() + batch_header_size + i * batch_entry_size, this->batch_buffers[i].size());
+			payload.push_back({this->batch_buffers[i].data(), this->batch_buffers[i].size()});
+		}
+	}
+
+	if (this->debug)
+		std::cout << "Sending a batch of " << count << " images\n";
+	this->sendFrame(MSG_IMAGE_BATCH, payload, this->keep_channels ? FLAG_KEEP_CHANNELS : 0, this->image_codec);
+}
+
+/**
+ * @brief A setter function for how sendImage encodes images. The codec travels
+ * in the frame header, so the receiver decodes each image with the right codec.
+ * JPEG, PNG and WebP are detected by the decoder, so they also work with text
+ * framing. CODEC_RAW and keep_channels need binary framing.
+ * @param codec CODEC_JPEG, CODEC_PNG, CODEC_WEBP or CODEC_RAW (no encoding, like sendMat)
+ * @param quality JPEG quality (0-100), PNG compression level (0-9) or WebP quality
+ * (1-100, above 100 is lossless). -1 uses the OpenCV default, ignored by CODEC_RAW.
+ * @param keep_channels If true, the receiver decodes images with their own
+ * channels and depth, e.g. grayscale stays single channel instead of becoming BGR
+ */
+void EzCppSocket::setImageCodec(ImageCodec codec, int quality, bool keep_channels)
+{
+	if (codec > CODEC_RAW)
+	{
+		printf("Unknown image codec %d\n", codec);
+		return;
+	}
+	this->image_codec = codec;
+	this->image_quality = quality;
+	this->keep_channels = keep_channels;
+}
+
+/**
+ * @brief A getter function for the codec used by sendImage
+ * @return ImageCodec Image codec
+ */
+EzCppSocket::ImageCodec EzCppSocket::getImageCodec()
+{
+	return this->image_codec;
+}
+
+/**
+ * @brief A setter function to split images sent by sendImage into horizontal
+ * stripes (binary framing required). The stripes are encoded in parallel and
+ * sent as one message, and the receiver decodes them in parallel into one
+ * image, so codec time scales with the number of cores. Readers of this
+ * library always accept tiled images, whatever their own setting.
+ * Ignored by CODEC_RAW.
+ * @param tile_count Number of stripes (1 sends whole images)
+ * @param thread_count Threads encoding/decoding the stripes of this socket (0 uses one per core)
+ */
+void EzCppSocket::setImageTiles(unsigned int tile_count, unsigned int thread_count)
+{
+	if (thread_count == 0)
+		thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+	this->image_tiles = std::max(tile_count, 1u);
+	if (thread_count != this->tile_threads)
+	{
+		std::lock_guard<std::mutex> lock(this->tile_pool_mutex);
+		this->tile_pool.reset();
+	}
+	this->tile_threads = thread_count;
+}
+
+/**
+ * @brief A getter function for the number of stripes sendImage splits images into
+ * @return unsigned int Number of stripes
+ */
+unsigned int EzCppSocket::getImageTiles()
+{
+	return this->image_tiles;
+}
+
+/**
+ * @brief A setter function to decode tiled images (see setImageTiles) while
+ * they are received: readImage hands each stripe to the tile pool as soon as
+ * its bytes have arrived, so decoding overlaps with the transfer of the rest of
+ * the image. Images that are not tiled are read as usual.
+ * @param enable Whether readImage decodes tiled images while receiving them
+ * @param tile_callback Optional function called with the image being filled in,
+ * the first row and the number of rows of each stripe once it is decoded. It is
+ * called from the tile pool threads, one stripe at a time, before readImage returns.
+ */
+void EzCppSocket::setStreamingImages(bool enable, TileCallback tile_callback)
+{
+	this->streaming_images = enable;
+	this->tile_callback = tile_callback;
+}
+
+/**
+ * @brief A getter function for whether readImage decodes tiled images while receiving them
+ * @return true Streaming decode is enabled
+ */
+bool EzCppSocket::getStreamingImages()
+{
+	return this->streaming_images;
+}
+
+/**
+ * @brief A setter function to send only the parts of an image that changed
+ * (binary framing required). sendImage splits images into square tiles and
+ * sends only the tiles whose mean absolute difference to what was last sent
+ * exceeds the threshold, and readImage patches them into the last image it
+ * returned. Every keyframe_interval images a whole image (keyframe) is sent,
+ * which also lets a receiver that missed images catch up.
+ * Ignored by CODEC_RAW.
+ * @param enable Whether sendImage sends delta images
+ * @param tile_size Width and height of the tiles in pixels (rounded up to a multiple of 16)
+ * @param threshold Mean absolute difference per channel value above which a tile is sent
+ * @param keyframe_interval Images between keyframes (0 sends a keyframe only when the image size changes)
+ */
+void EzCppSocket::setDeltaImages(bool enable, unsigned int tile_size, double threshold, unsigned int keyframe_interval)
+{
+	this->delta_images = enable;
+	this->delta_tile_size = std::max((tile_size + 15) / 16 * 16, 16u);
+	this->delta_threshold = threshold;
+	this->keyframe_interval = keyframe_interval;
+	// Start over with a keyframe
+	this->delta_reference.release();
+}
+
+/**
+ * @brief A getter function for whether sendImage sends delta images
+ * @return true Delta images are enabled
+ */
+bool EzCppSocket::getDeltaImages()
+{
+	return this->delta_images;
+}
+
+/**
+ * @brief Pool encoding and decoding the stripes of tiled images, started on first use.
+ * Callers keep the returned pointer while they use the pool, so setImageTiles
+ * can replace it while another thread (duplex or publisher) is still working.
+ * @return std::shared_ptr<EzThreadPool> Tile pool
+ */
+std::shared_ptr<EzThreadPool> EzCppSocket::tilePool()
+{
+	std::lock_guard<std::mutex> lock(this->tile_pool_mutex);
+	if (!this->tile_pool)
+		this->tile_pool = std::make_shared<EzThreadPool>(this->tile_threads ? this->tile_threads : std::thread::hardware_concurrency());
+	return this->tile_pool;
+}
+
+/**
+ * @brief Extension and parameters of cv::imencode for the codec and quality
+ * set by setImageCodec (not CODEC_RAW)
+ * @param params Set to the codec parameters
+ * @return const char* Extension of the codec (".jpg", ".png" or ".webp")
+ */
+const char *EzCppSocket::codecParams(std::vector<int> &params)
+{
+	static const char *const extensions[] = {".jpg", ".png", ".webp"};
+	static const int quality_params[] = {cv::IMWRITE_JPEG_QUALITY, cv::IMWRITE_PNG_COMPRESSION, cv::IMWRITE_WEBP_QUALITY};
+	params.clear();
+	if (this->image_quality >= 0)
+		params = {quality_params[this->image_codec], this->image_quality};
+	return extensions[this->image_codec];
+}
+
+/**
+ * @brief Encode an image with the codec set by setImageCodec. Encoded images
+ * are written to encode_buffer, raw images are sent straight from the Mat.
+ * @param img Image to be sent
+ * @param mat_header Storage for the Mat header of CODEC_RAW
+ * @param flags Set to the frame flags to send along
+ * @param allow_delta Whether delta images (setDeltaImages) may be sent
+ * @return std::vector<struct iovec> Buffers that make up the payload, in order
+ */
+std::vector<struct iovec> EzCppSocket::encodeImage(const cv::Mat &img, uchar (&mat_header)[mat_header_size], uint8_t &flags,
+												   bool allow_delta)
+{
+	if (!this->binary_framing && (this->image_codec == CODEC_RAW || this->keep_channels))
+	{
+		std::cout << "Raw images and keep_channels need binary framing! Use setBinaryFraming on both ends.\n";
+		throw std::runtime_error("Image codec needs binary framing");
+	}
+	if (!this->binary_framing && (this->image_tiles > 1 || this->delta_images) && this->image_codec != CODEC_RAW)
+	{
+		std::cout << "Tiled and delta images need binary framing! Use setBinaryFraming on both ends.\n";
+		throw std::runtime_error("Image tiles need binary framing");
+	}
+	flags = this->keep_channels ? FLAG_KEEP_CHANNELS : 0;
+	if (this->image_codec == CODEC_RAW)
+		return this->matPayload(img, mat_header);
+
+	std::vector<int> params;
+	const char *extension = this->codecParams(params);
+	if (this->delta_images && allow_delta && !img.empty())
+	{
+		const bool keyframe_due = this->delta_reference.size() != img.size() || this->delta_reference.type() != img.type() ||
+								  (this->keyframe_interval > 0 && this->frames_since_keyframe + 1 >= this->keyframe_interval);
+		if (!keyframe_due)
+		{
+			flags |= FLAG_DELTA;
+			this->frames_since_keyframe++;
+			return this->encodeDelta(img, extension, params);
+		}
+		// The keyframe is sent whole (or tiled) and becomes the reference of the following deltas
+		flags |= FLAG_KEYFRAME;
+		img.copyTo(this->delta_reference);
+		this->frames_since_keyframe = 0;
+	}
+	if (this->image_tiles > 1 && !img.empty())
+	{
+		flags |= FLAG_TILED;
+		return this->encodeTiles(img, extension, params);
+	}
+	cv::imencode(extension, img, this->encode_buffer, params);
+	return {{this->encode_buffer.data(), this->encode_buffer.size()}};
+}
+
+/**
+ * @brief Decode an image payload with the codec and flags of the frame header
+ * that was just read (received_codec, received_flags)
+ * @param payload Received payload
+ * @param payload_size Size of the payload
+ * @return cv::Mat Decoded image (empty if the payload is empty)
+ */
+cv::Mat EzCppSocket::decodeImage(const uchar *payload, size_t payload_size)
+{
+	cv::Mat frame;
+	if (payload_size == 0)
+		return frame;
+
+	if (this->received_codec == CODEC_RAW)
+	{
+		if (payload_size < mat_header_size)
+			throw std::runtime_error("Raw image check in received message failed");
+		const uint32_t rows = getUint32(payload);
+		const uint32_t cols = getUint32(payload + 4);
+		const uint32_t type = getUint32(payload + 8);
+		const uint32_t step = getUint32(payload + 12);
+		if (!validMatHeader(rows, cols, type, step, payload_size - mat_header_size) ||
+			payload_size != mat_header_size + (size_t)rows * step)
+		{
+			std::cout << "Received raw image header does not match the size of the message received!\n";
+			throw std::runtime_error("Raw image check in received message failed");
+		}
+		if (rows == 0 || cols == 0)
+			return frame;
+		// The payload lives in the receive buffer, so the pixels are copied out
+		cv::Mat(rows, cols, type, const_cast<uchar *>(payload + mat_header_size), step).copyTo(frame);
+		return frame;
+	}
+
+	const int read_flag = (this->received_flags & FLAG_KEEP_CHANNELS) ? cv::IMREAD_UNCHANGED : cv::IMREAD_COLOR;
+	if (this->received_flags & FLAG_DELTA)
+		return this->decodeDelta(payload, payload_size, read_flag);
+	if (this->received_flags & FLAG_TILED)
+		frame = this->decodeTiles(payload, payload_size, read_flag);
+	else
+		frame = cv::imdecode(cv::Mat(1, payload_size, CV_8UC1, const_cast<uchar *>(payload)), read_flag);
+	if (this->received_flags & FLAG_KEYFRAME)
+		frame.copyTo(this->delta_frame);
+	return frame;
+}
+
+/**
+ * @brief Encode the tiles of an image that changed since they were last sent
+ * (see setDeltaImages). Tiles are compared with delta_reference and encoded in
+ * parallel on the tile pool, and the tiles that were sent are copied into
+ * delta_reference. The tiles are written to tile_buffers and the delta image
+ * header and tile table to tile_table.
+ * @param img Image to be sent (same size and type as delta_reference)
+ * @param extension Extension of the codec (".jpg", ".png" or ".webp")
+ * @param params Codec parameters
+ * @return std::vector<struct iovec> Buffers that make up the payload, in order
+ */
+std::vector<struct iovec> EzCppSocket::encodeDelta(const cv::Mat &img, const char *extension, const std::vector<int> &params)
+{
+	const int tile_size = this->delta_tile_size;
+	const int tiles_x = (img.cols + tile_size - 1) / tile_size;
+	const size_t tile_count = tiles_x * ((img.rows + tile_size - 1) / tile_size);
+
+	this->tile_buffers.resize(tile_count);
+	std::vector<uchar> changed(tile_count, 0);
+	std::atomic<bool> failed{false};
+	this->tilePool()->run(tile_count, [&](size_t tile) {
+		const int x = (tile % tiles_x) * tile_size, y = (tile / tiles_x) * tile_size;
+		const cv::Rect rect(x, y, std::min(tile_size, img.cols - x), std::min(tile_size, img.rows - y));
+		try
+		{
+			// Mean absolute difference per channel value
+			cv::Mat reference = this->delta_reference(rect);
+			if (cv::norm(img(rect), reference, cv::NORM_L1) <= this->delta_threshold * rect.area() * img.channels())
+				return;
+			cv::imencode(extension, img(rect), this->tile_buffers[tile], params);
+			img(rect).copyTo(reference);
+			changed[tile] = 1;
+		}
+		catch (const std::exception &e)
+		{
+			std::cout << "Encoding image tile failed : " << e.what() << "\n";
+			failed = true;
+		}
+	});
+	if (failed)
+		throw std::runtime_error("Encoding image tile failed");
+
+	const size_t changed_count = std::count(changed.begin(), changed.end(), 1);
+	this->tile_table.resize(delta_header_size + changed_count * delta_entry_size);
+	putUint32(this->tile_table.data(), img.rows);
+	putUint32(this->tile_table.data() + 4, img.cols);
+	putUint32(this->tile_table.data() + 8, changed_count);
+
+	std::vector<struct iovec> payload;
+	payload.reserve(changed_count + 1);
+	payload.push_back({this->tile_table.data(), this->tile_table.size()});
+	uchar *entry = this->tile_table.data() + delta_header_size;
+	for (size_t tile = 0; tile < tile_count; tile++)
+	{
+		if (!changed[tile])
+			continue;
+		putUint32(entry, (tile % tiles_x) * tile_size);
+		putUint32(entry + 4, (tile / tiles_x) * tile_size);
+		putUint32(entry + 8, this->tile_buffers[tile].size());
+		entry += delta_entry_size;
+		payload.push_back({this->tile_buffers[tile].data(), this->tile_buffers[tile].size()});
+	}
+	if (this->debug)
+		std::cout << "Delta image : " << changed_count << " of " << tile_count << " tiles changed\n";
+	return payload;
+}
+
+/**
+ * @brief Decode a delta image payload (FLAG_DELTA) by patching its tiles into
+ * the image kept from the last keyframe and deltas (delta_frame). The tiles are
+ * decoded in parallel on the tile pool.
+ * @param payload Received payload
+ * @param payload_size Size of the payload
+ * @param read_flag cv::imdecode flag
+ * @return cv::Mat Copy of the patched image (empty if no keyframe was received yet)
+ */
+cv::Mat EzCppSocket::decodeDelta(const uchar *payload, size_t payload_size, int read_flag)
+{
+	if (payload_size < delta_header_size)
+		throw std::runtime_error("Delta image check in received message failed");
+	const int rows = getUint32(payload);
+	const int cols = getUint32(payload + 4);
+	const size_t tile_count = getUint32(payload + 8);
+	if (payload_size < delta_header_size + tile_count * delta_entry_size)
+		throw std::runtime_error("Delta image check in received message failed");
+
+	// Payload offset of each tile (and the end of the last one)
+	std::vector<size_t> offsets(tile_count + 1, delta_header_size + tile_count * delta_entry_size);
+	for (size_t tile = 0; tile < tile_count; tile++)
+		offsets[tile + 1] = offsets[tile] + getUint32(payload + delta_header_size + tile * delta_entry_size + 8);
+	if (offsets[tile_count] != payload_size)
+	{
+		std::cout << "Received tile table does not match the size of the message received!\n";
+		throw std::runtime_error("Delta image check in received message failed");
+	}
+	if (this->delta_frame.rows != rows || this->delta_frame.cols != cols)
+	{
+		std::cout << "Received a delta image without its keyframe, skipping images until the next keyframe...\n";
+		return cv::Mat();
+	}
+
+	std::atomic<bool> failed{false};
+	this->tilePool()->run(tile_count, [&](size_t tile) {
+		const uchar *entry = payload + delta_header_size + tile * delta_entry_size;
+		const int x = getUint32(entry), y = getUint32(entry + 4);
+		try
+		{
+			cv::Mat patch = cv::imdecode(cv::Mat(1, offsets[tile + 1] - offsets[tile], CV_8UC1, const_cast<uchar *>(payload + offsets[tile])), read_flag);
+			if (patch.empty() || patch.type() != this->delta_frame.type() || x < 0 || y < 0 ||
+				x + patch.cols > cols || y + patch.rows > rows)
+			{
+				failed = true;
+				return;
+			}
+			patch.copyTo(this->delta_frame(cv::Rect(x, y, patch.cols, patch.rows)));
+		}
+		catch (const std::exception &e)
+		{
+			std::cout << "Decoding image tile failed : " << e.what() << "\n";
+			failed = true;
+		}
+	});
+	if (failed)
+		throw std::runtime_error("Decoding image tile failed");
+	return this->delta_frame.clone();
+}
+
+/**
+ * @brief Encode an image as horizontal stripes in parallel on the tile pool
+ * (see setImageTiles). The stripes are written to tile_buffers and the tiled
+ * image header and tile table to tile_table.
+ * @param img Image to be sent
+ * @param extension Extension of the codec (".jpg", ".png" or ".webp")
+ * @param params Codec parameters
+ * @return std::vector<struct iovec> Buffers that make up the payload, in order
+ */
+std::vector<struct iovec> EzCppSocket::encodeTiles(const cv::Mat &img, const char *extension, const std::vector<int> &params)
+{
+	// Stripe heights are a multiple of 16 rows, so stripe edges fall on JPEG block boundaries
+	const int rows_per_tile = ((img.rows + this->image_tiles - 1) / this->image_tiles + 15) / 16 * 16;
+	const size_t tile_count = (img.rows + rows_per_tile - 1) / rows_per_tile;
+
+	this->tile_buffers.resize(tile_count);
+	std::atomic<bool> failed{false};
+	this->tilePool()->run(tile_count, [&](size_t tile) {
+		const int first_row = tile * rows_per_tile;
+		try
+		{
+			cv::imencode(extension, img.rowRange(first_row, std::min(first_row + rows_per_tile, img.rows)), this->tile_buffers[tile], params);
+		}
+		catch (const std::exception &e)
+		{
+			std::cout << "Encoding image tile failed : " << e.what() << "\n";
+			failed = true;
+		}
+	});
+	if (failed)
+		throw std::runtime_error("Encoding image tile failed");
+
+	this->tile_table.resize(tiled_header_size + tile_count * tile_entry_size);
+	putUint32(this->tile_table.data(), img.rows);
+	putUint32(this->tile_table.data() + 4, img.cols);
+	putUint32(this->tile_table.data() + 8, tile_count);
+
+	std::vector<struct iovec> payload;
+	payload.reserve(tile_count + 1);
+	payload.push_back({this->tile_table.data(), this->tile_table.size()});
+	for (size_t tile = 0; tile < tile_count; tile++)
+	{
+		uchar *entry = this->tile_table.data() + tiled_header_size + tile * tile_entry_size;
+		putUint32(entry, std::min<int>(rows_per_tile, img.rows - tile * rows_per_tile));
+		putUint32(entry + 4, this->tile_buffers[tile].size());
+		payload.push_back({this->tile_buffers[tile].data(), this->tile_buffers[tile].size()});
+	}
+	return payload;
+}
+
+/**
+ * @brief Check a tiled image header and tile table (see tiled_header_size) and
+ * compute where each stripe starts.
+ * @param table Tiled image header followed by the tile table
+ * @param first_rows Set to the first row of each stripe (and the rows of the image)
+ * @param offsets Set to the payload offset of each stripe (and the end of the last one)
+ * @return size_t Number of stripes
+ */
+size_t EzCppSocket::parseTileTable(const uchar *table, std::vector<size_t> &first_rows, std::vector<size_t> &offsets)
+{
+	const size_t tile_count = getUint32(table + 8);
+	first_rows.assign(tile_count + 1, 0);
+	offsets.assign(tile_count + 1, tiled_header_size + tile_count * tile_entry_size);
+	for (size_t tile = 0; tile < tile_count; tile++)
+	{
+		const uchar *entry = table + tiled_header_size + tile * tile_entry_size;
+		first_rows[tile + 1] = first_rows[tile] + getUint32(entry);
+		offsets[tile + 1] = offsets[tile] + getUint32(entry + 4);
+	}
+	if (first_rows[tile_count] != getUint32(table))
+	{
+		std::cout << "Received tile table does not match the rows of the image received!\n";
+		throw std::runtime_error("Tiled image check in received message failed");
+	}
+	return tile_count;
+}
+
+/**
+ * @brief Decode one stripe of a tiled image into its rows of the image. The
+ * image is created by the first stripe decoded, which gives its type.
+ * @param data Encoded stripe
+ * @param size Size of the encoded stripe
+ * @param read_flag cv::imdecode flag
+ * @param frame Image being assembled (created if empty)
+ * @param frame_mutex Guards the creation of frame
+ * @param first_row First row of the stripe
+ * @param row_count Rows of the stripe
+ * @param cols Columns of the image
+ * @param rows Rows of the image
+ * @return true The stripe was decoded into frame
+ * @return false The stripe could not be decoded or does not fit the image
+ */
+bool EzCppSocket::decodeTile(const uchar *data, size_t size, int read_flag, cv::Mat &frame, std::mutex &frame_mutex,
+							 int first_row, int row_count, int cols, int rows)
+{
+	try
+	{
+		cv::Mat stripe = cv::imdecode(cv::Mat(1, size, CV_8UC1, const_cast<uchar *>(data)), read_flag);
+		if (stripe.rows != row_count || stripe.cols != cols)
+			return false;
+		cv::Mat rows_of_tile;
+		{
+			std::lock_guard<std::mutex> lock(frame_mutex);
+			if (frame.empty())
+				frame.create(rows, cols, stripe.type());
+			if (stripe.type() != frame.type())
+				return false;
+			rows_of_tile = frame.rowRange(first_row, first_row + row_count);
+		}
+		stripe.copyTo(rows_of_tile);
+		return true;
+	}
+	catch (const std::exception &e)
+	{
+		std::cout << "Decoding image tile failed : " << e.what() << "\n";
+		return false;
+	}
+}
+
+/**
+ * @brief Decode a tiled image payload (FLAG_TILED). The stripes are decoded in
+ * parallel on the tile pool, each straight into its rows of the returned image.
+ * @param payload Received payload
+ * @param payload_size Size of the payload
+ * @param read_flag cv::imdecode flag
+ * @return cv::Mat Decoded image
+ */
+cv::Mat EzCppSocket::decodeTiles(const uchar *payload, size_t payload_size, int read_flag)
+{
+	if (payload_size < tiled_header_size ||
+		payload_size < tiled_header_size + size_t(getUint32(payload + 8)) * tile_entry_size)
+		throw std::runtime_error("Tiled image check in received message failed");
+	std::vector<size_t> first_rows, offsets;
+	const size_t tile_count = this->parseTileTable(payload, first_rows, offsets);
+	if (offsets[tile_count] != payload_size)
+	{
+		std::cout << "Received tile table does not match the size of the message received!\n";
+		throw std::runtime_error("Tiled image check in received message failed");
+	}
+
+	const int rows = getUint32(payload);
+	const int cols = getUint32(payload + 4);
+	cv::Mat frame;
+	std::mutex frame_mutex;
+	std::atomic<bool> failed{false};
+	this->tilePool()->run(tile_count, [&](size_t tile) {
+		if (!this->decodeTile(payload + offsets[tile], offsets[tile + 1] - offsets[tile], read_flag, frame, frame_mutex,
+							  first_rows[tile], first_rows[tile + 1] - first_rows[tile], cols, rows))
+			failed = true;
+	});
+	if (failed)
+		throw std::runtime_error("Decoding image tile failed");
+	return frame;
+}
+
+/**
+ * @brief Read an image message, decoding the stripes of a tiled image on the
+ * tile pool while the following ones are still being received (see
+ * setStreamingImages). Other images are read and decoded whole.
+ * @param payload_size Set to the size of the payload (without tokens)
+ * @return cv::Mat Decoded image
+ */
+cv::Mat EzCppSocket::readStreamingImage(size_t &payload_size)
+{
+	const size_t message_size = this->readHeader(MSG_IMAGE);
+	const size_t start_size = this->tokens.first.length();
+	const size_t token_size = start_size + this->tokens.second.length();
+	if (!(this->received_flags & FLAG_TILED) || this->received_codec == CODEC_RAW ||
+		message_size < token_size + tiled_header_size)
+	{
+		const uchar *payload = this->readMessage(message_size, payload_size);
+		return this->decodeImage(payload, payload_size);
+	}
+
+	// Start token, tiled image header and tile table first
+	uchar *buffer = this->reserveReceiveBuffer(message_size);
+	uchar *payload = buffer + start_size;
+	payload_size = message_size - token_size;
+	this->readFully(buffer, start_size + tiled_header_size);
+	const size_t table_size = tiled_header_size + size_t(getUint32(payload + 8)) * tile_entry_size;
+	if (payload_size < table_size)
+		throw std::runtime_error("Tiled image check in received message failed");
+	this->readFully(payload + tiled_header_size, table_size - tiled_header_size);
+	std::vector<size_t> first_rows, offsets;
+	const size_t tile_count = this->parseTileTable(payload, first_rows, offsets);
+	if (offsets[tile_count] != payload_size)
+	{
+		std::cout << "Received tile table does not match the size of the message received!\n";
+		throw std::runtime_error("Tiled image check in received message failed");
+	}
+
+	const int rows = getUint32(payload);
+	const int cols = getUint32(payload + 4);
+	const int read_flag = (this->received_flags & FLAG_KEEP_CHANNELS) ? cv::IMREAD_UNCHANGED : cv::IMREAD_COLOR;
+	std::shared_ptr<EzThreadPool> pool = this->tilePool();
+	cv::Mat frame;
+	std::mutex frame_mutex, callback_mutex, done_mutex;
+	std::condition_variable done;
+	size_t pending = 0;
+	bool failed = false;
+	auto wait_for_tiles = [&] {
+		std::unique_lock<std::mutex> lock(done_mutex);
+		done.wait(lock, [&] { return pending == 0; });
+	};
+
+	try
+	{
+		for (size_t tile = 0; tile < tile_count; tile++)
+		{
+			this->readFully(payload + offsets[tile], offsets[tile + 1] - offsets[tile]);
+			{
+				std::lock_guard<std::mutex> lock(done_mutex);
+				pending++;
+			}
+			pool->submit([&, tile] {
+				const int first_row = first_rows[tile], row_count = first_rows[tile + 1] - first_rows[tile];
+				bool decoded = this->decodeTile(payload + offsets[tile], offsets[tile + 1] - offsets[tile], read_flag,
+												frame, frame_mutex, first_row, row_count, cols, rows);
+				if (decoded && this->tile_callback)
+				{
+					std::lock_guard<std::mutex> lock(callback_mutex);
+					try
+					{
+						this->tile_callback(frame, first_row, row_count);
+					}
+					catch (const std::exception &e)
+					{
+						std::cout << "Tile callback failed : " << e.what() << "\n";
+						decoded = false;
+					}
+				}
+
+				std::lock_guard<std::mutex> lock(done_mutex);
+				failed = failed || !decoded;
+				if (--pending == 0)
+					done.notify_all();
+			});
+		}
+		this->readFully(payload + payload_size, this->tokens.second.length());
+	}
+	catch (...)
+	{
+		// The stripes being decoded point into the receive buffer
+		wait_for_tiles();
+		throw;
+	}
+	wait_for_tiles();
+
+	if (!this->checkTokens(buffer, message_size))
+	{
+		payload_size = 0;
+		return cv::Mat();
+	}
+	if (failed)
+		throw std::runtime_error("Decoding image tile failed");
+	if (this->received_flags & FLAG_KEYFRAME)
+		frame.copyTo(this->delta_frame);
+	return frame;
+}
+
+/**
+ * @brief Send a raw OpenCV Mat, skipping image encoding. A small header
+ * (rows, cols, type, step) is sent followed by the pixel data taken
+ * directly from the Mat. Non continuous Mats are sent row by row.
+ * 
+ * @param img Mat to be sent
+ */
+void EzCppSocket::sendMat(const cv::Mat &img)
+{
+	if (this->sendSharedMat(img))
+		return;
+
+	if (this->debug)
+		std::cout << "sendMat rows : " << img.rows << " cols : " << img.cols << " type : " << img.type()
+				  << " continuous : " << img.isContinuous() << "\n";
+
+	uchar mat_header[mat_header_size];
+	this->sendFrame(MSG_MAT, this->matPayload(img, mat_header));
+}
+
+/**
+ * @brief Gather the payload of a raw Mat: the Mat header followed by the pixel
+ * data taken directly from the Mat (row by row if it is not continuous)
+ * @param img Mat to be sent
+ * @param mat_header Storage for the Mat header, must outlive the returned buffers
+ * @return std::vector<struct iovec> Buffers that make up the payload, in order
+ */
+std::vector<struct iovec> EzCppSocket::matPayload(const cv::Mat &img, uchar (&mat_header)[mat_header_size])
+{
+	const size_t row_size = img.cols * img.elemSize();
+
+	putUint32(mat_header, img.rows);
+	putUint32(mat_header + 4, img.cols);
+	putUint32(mat_header + 8, img.type());
+	putUint32(mat_header + 12, row_size);
+
+	std::vector<struct iovec> payload;
+	payload.push_back({mat_header, mat_header_size});
+	if (img.isContinuous())
+		payload.push_back({img.data, img.rows * row_size});
+	else
+		for (int row = 0; row < img.rows; row++)
+			payload.push_back({const_cast<uchar *>(img.ptr(row)), row_size});
+	return payload;
+}
+
+/**
+ * @brief A setter function to send Mats through shared memory (same host only,
+ * binary framing required). A ring of slot_count slots of slot_size bytes is
+ * created with shm_open and sendMat copies each Mat into the next slot, so only
+ * a small notification goes through the socket. The receiving readMat maps the
+ * ring and returns a Mat pointing into the slot without copying it.
+ * Mats that do not fit in a slot, or that find the next slot still in use by
+ * the receiver, are sent through the socket as usual.
+ * @param slot_count Number of slots (at least 2, 0 disables shared memory)
+ * @param slot_size Size of each slot in bytes (e.g. rows * cols * channels of the largest frame)
+ */
+void EzCppSocket::setSharedMemory(unsigned int slot_count, size_t slot_size)
+{
+	unmapSharedMemory(this->shm_outbound);
+	this->shm_attach_sent = false;
+	if (slot_count == 0)
+		return;
+	if (slot_count < 2)
+		throw std::invalid_argument("Shared memory needs at least 2 slots");
+
+	static std::atomic<unsigned int> ring_counter{0};
+	EzSharedMemoryRing &ring = this->shm_outbound;
+	ring.name = "/ezcppsocket_" + std::to_string(getpid()) + "_" + std::to_string(ring_counter++);
+	ring.slot_count = slot_count;
+	ring.slot_size = (slot_size + 63) / 64 * 64;
+	ring.next_slot = 0;
+
+	const size_t page_size = sysconf(_SC_PAGESIZE);
+	const size_t data_offset = (shm_header_size + slot_count * shm_state_stride + page_size - 1) / page_size * page_size;
+	const size_t size = data_offset + slot_count * ring.slot_size;
+
+	int shm_fd = shm_open(ring.name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (shm_fd < 0 || ftruncate(shm_fd, size) < 0 || !mapSharedMemory(ring, shm_fd, size))
+	{
+		perror("Shared memory creation failed");
+		if (shm_fd >= 0)
+		{
+			close(shm_fd);
+			shm_unlink(ring.name.c_str());
+		}
+		throw std::runtime_error("Creating shared memory ring failed");
+	}
+	close(shm_fd);
+
+	// New memory is zero filled, so all slots start out SHM_SLOT_FREE
+	putUint32(ring.base, shm_magic);
+	putUint32(ring.base + 4, slot_count);
+	putUint32(ring.base + 8, ring.slot_size & 0xFFFFFFFF);
+	putUint32(ring.base + 12, (uint64_t)ring.slot_size >> 32);
+	ring.data_offset = data_offset;
+}
+
+/**
+ * @brief Map a shared memory object into ring
+ * @return false mmap failed
+ */
+bool EzCppSocket::mapSharedMemory(EzSharedMemoryRing &ring, int shm_fd, size_t size)
+{
+	void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+	if (base == MAP_FAILED)
+		return false;
+	ring.base = static_cast<uchar *>(base);
+	ring.mapped_size = size;
+	return true;
+}
+
+/**
+ * @brief Unmap a ring. The ring of the sending side is also unlinked (the
+ * receiving side unlinks it as soon as it is mapped, so this may find nothing).
+ */
+void EzCppSocket::unmapSharedMemory(EzSharedMemoryRing &ring)
+{
+	if (ring.base != nullptr)
+		munmap(ring.base, ring.mapped_size);
+	if (!ring.name.empty())
+		shm_unlink(ring.name.c_str());
+	ring = EzSharedMemoryRing();
+}
+
+/**
+ * @brief State word of a slot
+ */
+uint32_t *EzCppSocket::sharedSlotState(EzSharedMemoryRing &ring, unsigned int slot)
+{
+	return reinterpret_cast<uint32_t *>(ring.base + shm_header_size + slot * shm_state_stride);
+}
+
+/**
+ * @brief Send a Mat through the shared memory ring, if one is set up
+ * @param img Mat to be sent
+ * @return false The Mat has to be sent through the socket instead
+ */
+bool EzCppSocket::sendSharedMat(const cv::Mat &img)
+{
+	EzSharedMemoryRing &ring = this->shm_outbound;
+	if (ring.base == nullptr)
+		return false;
+	if (!this->binary_framing)
+		throw std::runtime_error("Shared memory transport requires binary framing");
+
+	const size_t row_size = img.cols * img.elemSize();
+	const unsigned int slot = ring.next_slot;
+	uint32_t *state = sharedSlotState(ring, slot);
+	if (img.rows * row_size > ring.slot_size || __atomic_load_n(state, __ATOMIC_ACQUIRE) != SHM_SLOT_FREE)
+		return false;
+
+	if (!this->shm_attach_sent)
+	{
+		uchar attach[shm_attach_header_size] = {0};
+		putUint32(attach, ring.slot_count);
+		putUint32(attach + 8, ring.slot_size & 0xFFFFFFFF);
+		putUint32(attach + 12, (uint64_t)ring.slot_size >> 32);
+		this->sendFrame(MSG_SHM_ATTACH, {{attach, shm_attach_header_size}, {&ring.name[0], ring.name.length()}});
+		this->shm_attach_sent = true;
+	}
+
+	uchar *slot_data = ring.base + ring.data_offset + slot * ring.slot_size;
+	if (img.isContinuous())
+		memcpy(slot_data, img.data, img.rows * row_size);
+	else
+		for (int row = 0; row < img.rows; row++)
+			memcpy(slot_data + row * row_size, img.ptr(row), row_size);
+	__atomic_store_n(state, SHM_SLOT_READY, __ATOMIC_RELEASE);
+	ring.next_slot = (slot + 1) % ring.slot_count;
+
+	uchar notification[shm_mat_header_size] = {0};
+	putUint32(notification, slot);
+	putUint32(notification + 4, img.rows);
+	putUint32(notification + 8, img.cols);
+	putUint32(notification + 12, img.type());
+	putUint32(notification + 16, row_size);
+	this->sendFrame(MSG_SHM_MAT, {{notification, shm_mat_header_size}});
+	return true;
+}
+
+/**
+ * @brief Map the shared memory ring announced by the peer
+ * @param payload MSG_SHM_ATTACH payload
+ * @param payload_size Size of the payload
+ */
+void EzCppSocket::attachSharedMemory(const uchar *payload, size_t payload_size)
+{
+	if (payload_size <= shm_attach_header_size)
+		throw std::runtime_error("Shared memory attach message is too short");
+
+	unmapSharedMemory(this->shm_inbound);
+	this->shm_held_slot = -1;
+
+	EzSharedMemoryRing &ring = this->shm_inbound;
+	const std::string name(payload + shm_attach_header_size, payload + payload_size);
+	int shm_fd = shm_open(name.c_str(), O_RDWR, 0600);
+	struct stat shm_stat;
+	if (shm_fd < 0 || fstat(shm_fd, &shm_stat) < 0 || !mapSharedMemory(ring, shm_fd, shm_stat.st_size))
+	{
+		perror("Shared memory attach failed");
+		if (shm_fd >= 0)
+			close(shm_fd);
+		throw std::runtime_error("Attaching to shared memory ring of peer failed");
+	}
+	close(shm_fd);
+	// Nothing else needs the name, unlinking now leaves nothing behind if a process dies
+	shm_unlink(name.c_str());
+
+	ring.slot_count = getUint32(ring.base + 4);
+	ring.slot_size = getUint32(ring.base + 8) | ((uint64_t)getUint32(ring.base + 12) << 32);
+	const size_t page_size = sysconf(_SC_PAGESIZE);
+	ring.data_offset = (shm_header_size + ring.slot_count * shm_state_stride + page_size - 1) / page_size * page_size;
+	if (getUint32(ring.base) != shm_magic || ring.data_offset + ring.slot_count * ring.slot_size > ring.mapped_size)
+	{
+		unmapSharedMemory(ring);
+		throw std::runtime_error("Shared memory ring of peer is invalid");
+	}
+
+	if (this->debug)
+		std::cout << "Attached shared memory " << name << " slots : " << ring.slot_count << " slot size : " << ring.slot_size << "\n";
+}
+
+/**
+ * @brief Return the Mat announced by a MSG_SHM_MAT notification. The Mat points
+ * into the shared slot, which is handed back to the sender on the next readMat.
+ * @param payload MSG_SHM_MAT payload
+ * @param payload_size Size of the payload
+ * @return cv::Mat Mat pointing into shared memory
+ */
+cv::Mat EzCppSocket::readSharedMat(const uchar *payload, size_t payload_size)
+{
+	EzSharedMemoryRing &ring = this->shm_inbound;
+	if (payload_size < shm_mat_header_size || ring.base == nullptr)
+		throw std::runtime_error("Shared memory Mat received without a shared memory ring");
+
+	const unsigned int slot = getUint32(payload);
+	const uint32_t rows = getUint32(payload + 4);
+	const uint32_t cols = getUint32(payload + 8);
+	const uint32_t type = getUint32(payload + 12);
+	const uint32_t step = getUint32(payload + 16);
+	if (slot >= ring.slot_count || !validMatHeader(rows, cols, type, step, ring.slot_size) ||
+		__atomic_load_n(sharedSlotState(ring, slot), __ATOMIC_ACQUIRE) != SHM_SLOT_READY)
+		throw std::runtime_error("Shared memory Mat check in received message failed");
+
+	if (this->debug)
+		std::cout << "readMat (shared memory) slot : " << slot << " rows : " << rows << " cols : " << cols << " type : " << type << "\n";
+
+	this->shm_held_slot = slot;
+	if (rows == 0 || cols == 0)
+		return cv::Mat();
+	return cv::Mat(rows, cols, type, ring.base + ring.data_offset + slot * ring.slot_size, step);
+}
+
+/**
+ * @brief Hand the slot of the last shared memory Mat back to the sender
+ */
+void EzCppSocket::releaseSharedSlot()
+{
+	if (this->shm_held_slot < 0)
+		return;
+	if (this->shm_inbound.base != nullptr)
+		__atomic_store_n(sharedSlotState(this->shm_inbound, this->shm_held_slot), SHM_SLOT_FREE, __ATOMIC_RELEASE);
+	this->shm_held_slot = -1;
+}
+
+/**
+ * @brief Start duplex mode. A writer thread encodes and sends the images
+ * queued with postImage and a reader thread receives and decodes images into a
+ * queue drained with pollImage, so sending and receiving overlap and several
+ * images can be in flight at once. Both queues hold up to queue_depth images;
+ * the inbound one is lock-free, and policy sets what postImage does when the
+ * outbound one is full.
+ * While duplex mode is active, images must only be exchanged through
+ * postImage/pollImage, and no other message may be sent or read.
+ * 
+ * With SOCK_DGRAM, setDatagramTimeout has to be used first so that stopDuplex
+ * cannot hang on a frame that never completes.
+ * 
+ * @param queue_depth Number of images each queue can hold
+ * @param policy OVERFLOW_DROP_NEWEST (postImage returns false), OVERFLOW_DROP_OLDEST
+ * (the oldest queued image is dropped, keeping latency flat) or OVERFLOW_BLOCK
+ * (postImage waits for the writer)
+ */
+void EzCppSocket::startDuplex(size_t queue_depth, OverflowPolicy policy)
+{
+	if (this->duplex_running)
+		return;
+	if (this->socket_type == SOCK_DGRAM && this->datagram_timeout == 0)
+	{
+		// Otherwise a lone datagram would keep the reader waiting for the rest of its frame forever
+		std::cout << "Duplex mode with SOCK_DGRAM needs a datagram timeout! Use setDatagramTimeout before startDuplex.\n";
+		throw std::runtime_error("Duplex mode needs a datagram timeout");
+	}
+
+	this->duplex_outbound.reset(new EzBoundedQueue<cv::Mat>(std::max(queue_depth, (size_t)1)));
+	this->duplex_policy = policy;
+	this->duplex_inbound.reset(new EzSpscQueue<cv::Mat>(std::max(queue_depth, (size_t)1)));
+	this->duplex_failed = false;
+	this->duplex_posted_count = 0;
+	this->duplex_polled_count = 0;
+	this->duplex_running = true;
+	this->duplex_reader = std::thread(&EzCppSocket::duplexReaderLoop, this);
+	this->duplex_writer = std::thread(&EzCppSocket::duplexWriterLoop, this);
+}
+
+/**
+ * @brief Stop duplex mode. Images already posted are sent before the writer
+ * exits. Received images that were not polled are discarded, and replies still
+ * on their way stay in the socket for the next read.
+ */
+void EzCppSocket::stopDuplex()
+{
+	if (!this->duplex_running)
+		return;
+
+	this->duplex_running = false;
+	this->duplex_outbound->close();
+	this->duplex_writer.join();
+	this->duplex_reader.join();
+	this->duplex_outbound.reset();
+	this->duplex_inbound.reset();
+}
+
+/**
+ * @brief Queue an image to be sent by the duplex writer thread. The image data
+ * is not copied, so the caller must not modify it afterwards (e.g. capture
+ * each frame into a new cv::Mat).
+ * 
+ * What happens when the outbound queue is full depends on the policy given to
+ * startDuplex. Dropped images are counted by getQueueDroppedFrames and are
+ * not counted as in flight.
+ * 
+ * @param img Image to be sent
+ * @return true Image was queued
+ * @return false Outbound queue is full and the image was dropped (OVERFLOW_DROP_NEWEST)
+ */
+bool EzCppSocket::postImage(const cv::Mat &img)
+{
+	if (!this->duplex_running)
+		throw std::runtime_error("Duplex mode is not active, call startDuplex first");
+	if (this->duplex_failed)
+		throw std::runtime_error("Duplex connection failed");
+
+	switch (this->duplex_policy)
+	{
+	case OVERFLOW_BLOCK:
+		// The writer closes the queue if it fails
+		if (!this->duplex_outbound->push(img))
+			throw std::runtime_error("Duplex connection failed");
+		break;
+	case OVERFLOW_DROP_OLDEST:
+		if (this->duplex_outbound->pushDropOldest(img))
+		{
+			// The dropped image will get no result
+			this->queue_dropped_count++;
+			return true;
+		}
+		break;
+	default:
+		if (!this->duplex_outbound->tryPush(img))
+		{
+			this->queue_dropped_count++;
+			return false;
+		}
+	}
+	this->duplex_posted_count++;
+	return true;
+}
+
+/**
+ * @brief Take the oldest image received by the duplex reader thread
+ * 
+ * @param img Received image
+ * @return true An image was received
+ * @return false No image is available yet
+ */
+bool EzCppSocket::pollImage(cv::Mat &img)
+{
+	if (!this->duplex_running)
+		throw std::runtime_error("Duplex mode is not active, call startDuplex first");
+
+	if (!this->duplex_inbound->tryPop(img))
+	{
+		if (this->duplex_failed)
+			throw std::runtime_error("Duplex connection failed");
+		return false;
+	}
+	this->duplex_polled_count++;
+	return true;
+}
+
+/**
+ * @brief Number of images posted in duplex mode whose result has not been
+ * polled yet. Useful to keep a fixed number of images in flight.
+ * 
+ * @return unsigned int Images in flight
+ */
+unsigned int EzCppSocket::getImagesInFlight()
+{
+	return this->duplex_posted_count - this->duplex_polled_count;
+}
+
+/**
+ * @brief Duplex reader thread. Waits for data with a timeout so stopDuplex is
+ * noticed, then reads a complete image and hands it to pollImage.
+ */
+void EzCppSocket::duplexReaderLoop()
+{
+	try
+	{
+		while (this->duplex_running)
+		{
+			struct pollfd socket_poll = {this->sock, POLLIN, 0};
+			int ready = this->hasBufferedData() ? 1 : poll(&socket_poll, 1, 100);
+			if (ready < 0 && errno != EINTR)
+			{
+				perror("poll");
+				throw std::runtime_error("Waiting for socket data failed");
+			}
+			if (ready <= 0)
+				continue;
+
+			cv::Mat img = this->readImage();
+			if (img.empty())
+				continue;
+			while (!this->duplex_inbound->tryPush(img))
+			{
+				if (!this->duplex_running)
+					return;
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+			}
+		}
+		return;
+	}
+	catch (const std::exception &e)
 	{
-		v.push_back(std::stoi(ss_elem));
+		printf("Duplex reader stopped : %s\n", e.what());
 	}
+	this->duplex_failed = true;
+}
 
-	if (this->debug)
+/**
+ * @brief Duplex writer thread. Encodes and sends posted images until duplex
+ * mode is stopped and the outbound queue is empty.
+ */
+void EzCppSocket::duplexWriterLoop()
+{
+	try
 	{
-		printf("readIntList buffer received: %s\n", buffer);
-		for (auto elem : v)
+		// stopDuplex closes the queue, the images left in it are still sent
+		cv::Mat img;
+		while (this->duplex_outbound->pop(img))
 		{
-			printf("%i ,", elem);
+			this->sendImage(img);
+			img.release();
 		}
-		std::cout << "\n";
+		return;
+	}
+	catch (const std::exception &e)
+	{
+		printf("Duplex writer stopped : %s\n", e.what());
 	}
+	this->duplex_failed = true;
+	this->duplex_outbound->close();
+}
 
-	return v;
+/**
+ * @brief Turn a multi-client server (client_connection_count greater than 1)
+ * into a publisher. Clients that connect become subscribers, and every image
+ * given to publishImage is encoded once and sent to all of them. Each
+ * subscriber has its own queue of up to queue_depth images and a sender
+ * thread. With the default OVERFLOW_DROP_OLDEST policy a slow subscriber skips
+ * to the latest images instead of stalling the others. Subscribers simply call
+ * readImage. Use publishImage instead of serverLoop.
+ * @param queue_depth Number of images each subscriber queue can hold
+ * @param policy What publishImage does for a subscriber whose queue is full:
+ * OVERFLOW_DROP_OLDEST, OVERFLOW_DROP_NEWEST or OVERFLOW_BLOCK (wait for it)
+ */
+void EzCppSocket::startPublisher(size_t queue_depth, OverflowPolicy policy)
+{
+	if (this->fd < 0 || this->client_connection_count <= 1)
+	{
+		std::cout << "Publishing needs a connection oriented server created with client_connection_count greater than 1!\n";
+		throw std::runtime_error("Publisher needs a multi-client server");
+	}
+	if (this->publisher_running)
+		return;
+	this->publisher_queue_depth = std::max(queue_depth, (size_t)1);
+	this->publisher_policy = policy;
+	this->publisher_running = true;
+	this->publisher_acceptor = std::thread(&EzCppSocket::publisherAcceptLoop, this);
+	printf("Publishing to up to %d subscribers ...\n", this->client_connection_count);
 }
 
 /**
- * @brief Read a list of float values
- * 
- * @return std::vector<int> Float List received
+ * @brief Stop publishing: no more subscribers are accepted, and the
+ * connections of the current ones are closed (images not sent yet are dropped).
  */
-std::vector<float> EzCppSocket::readFloatList()
+void EzCppSocket::stopPublisher()
+{
+	if (!this->publisher_running.exchange(false))
+		return;
+	this->publisher_acceptor.join();
+
+	std::lock_guard<std::mutex> lock(this->subscribers_mutex);
+	for (auto &subscriber : this->subscribers)
+	{
+		subscriber->queue.close();
+		// Unblocks a sender stuck writing to a stalled subscriber
+		shutdown(subscriber->connection->sock, SHUT_RDWR);
+		subscriber->sender.join();
+	}
+	this->subscribers.clear();
+}
+
+/**
+ * @brief Encode an image once and queue it to every subscriber (see
+ * startPublisher). Subscribers whose queue is full are handled with the policy
+ * given to startPublisher, and dropped images are counted by getQueueDroppedFrames.
+ * Delta images (setDeltaImages) are not used, since subscribers skip images.
+ * @param img Image to be published
+ */
+void EzCppSocket::publishImage(const cv::Mat &img)
 {
-	const int buffer_size = this->readInt(); // get message size
-	char buffer[buffer_size] = {0};
-	int valread = read(sock, buffer, buffer_size);
+	if (!this->publisher_running)
+		throw std::runtime_error("Call startPublisher before publishImage");
 
-	// remove the [] characters around the received list
-	std::string str(&buffer[0], &buffer[buffer_size]);
-	this->extractTokens(str);
-	str = str.substr(1, str.find("]") - 1);
+	uchar mat_header[mat_header_size];
+	uint8_t flags;
+	std::vector<struct iovec> payload = this->encodeImage(img, mat_header, flags, false);
 
-	std::stringstream ss(str);
-	std::string ss_elem; // substring
-	std::vector<float> v;
-	while (getline(ss, ss_elem, ','))
+	// The complete message is gathered into one buffer shared by all subscribers
+	uchar header[frame_header_size];
+	std::string size_message;
+	std::vector<struct iovec> message = this->buildFrame(MSG_IMAGE, payload, flags, this->image_codec, header, size_message);
+	size_t message_size = 0;
+	for (auto &part : message)
+		message_size += part.iov_len;
+	auto buffer = std::make_shared<std::vector<uchar>>(message_size);
+	uchar *ptr = buffer->data();
+	for (auto &part : message)
 	{
-		v.push_back(std::stof(ss_elem));
+		memcpy(ptr, part.iov_base, part.iov_len);
+		ptr += part.iov_len;
 	}
+	std::shared_ptr<const std::vector<uchar>> shared_message = buffer;
 
-	if (this->debug)
+	// Queue to a snapshot of the subscribers, so a push that waits (OVERFLOW_BLOCK)
+	// does not hold up the acceptor, getSubscriberCount or stopPublisher
+	std::vector<std::shared_ptr<Subscriber>> subscribers;
 	{
-		printf("readFloatList buffer received: %s\n", buffer);
-		for (auto elem : v)
+		std::lock_guard<std::mutex> lock(this->subscribers_mutex);
+		subscribers = this->subscribers;
+	}
+
+	bool disconnected = false;
+	for (auto &subscriber : subscribers)
+	{
+		EzBoundedQueue<std::shared_ptr<const std::vector<uchar>>> &queue = subscriber->queue;
+		bool dropped = false;
+		if (this->publisher_policy == OVERFLOW_BLOCK)
+			queue.push(shared_message);
+		else if (this->publisher_policy == OVERFLOW_DROP_OLDEST)
+			dropped = queue.pushDropOldest(shared_message);
+		else
+			dropped = !queue.tryPush(shared_message);
+
+		// A closed queue means its sender stopped after a failed write
+		disconnected |= queue.isClosed();
+		if (dropped && !queue.isClosed())
+			this->queue_dropped_count++;
+	}
+	if (!disconnected)
+		return;
+
+	std::lock_guard<std::mutex> lock(this->subscribers_mutex);
+	for (auto subscriber = this->subscribers.begin(); subscriber != this->subscribers.end();)
+	{
+		if (!(*subscriber)->queue.isClosed())
 		{
-			printf("%f ,", elem);
+			++subscriber;
+			continue;
 		}
-		std::cout << "\n";
+		(*subscriber)->sender.join();
+		subscriber = this->subscribers.erase(subscriber);
+		printf("Subscriber disconnected, %zu subscriber(s) ...\n", this->subscribers.size());
 	}
-	return v;
 }
 
 /**
- * @brief Read an OpenCV Image
- * 
- * @return cv::Mat Received Image
+ * @brief A getter function for the number of images dropped because an
+ * outbound queue was full (postImage in duplex mode, publishImage per subscriber)
+ * @return unsigned long Number of dropped images
  */
-cv::Mat EzCppSocket::readImage()
+unsigned long EzCppSocket::getQueueDroppedFrames()
+{
+	return this->queue_dropped_count;
+}
+
+/**
+ * @brief A getter function for the number of connected subscribers
+ * @return unsigned int Number of subscribers
+ */
+unsigned int EzCppSocket::getSubscriberCount()
 {
-	const int complete_buffer_size = this->readInt();
-	std::vector<uchar> data;
-	data.clear();
+	std::lock_guard<std::mutex> lock(this->subscribers_mutex);
+	unsigned int count = 0;
+	for (auto &subscriber : this->subscribers)
+		count += !subscriber->queue.isClosed();
+	return count;
+}
 
-	unsigned packet_start_index = 0;
-	unsigned int packet_size_curr = this->packet_size;
-	uchar buffer[this->packet_size] = {0};
-	// Read packets of size defined by packet_size
-	while (packet_start_index < complete_buffer_size)
+/**
+ * @brief Publisher thread accepting subscribers while there is a free slot.
+ * Waits with a timeout so stopPublisher is noticed.
+ */
+void EzCppSocket::publisherAcceptLoop()
+{
+	while (this->publisher_running)
 	{
-		if ((packet_start_index + this->packet_size) > complete_buffer_size)
-			packet_size_curr = complete_buffer_size - packet_start_index;
+		if ((int)this->getSubscriberCount() >= this->client_connection_count)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			continue;
+		}
+
+		struct pollfd server_poll = {this->fd, POLLIN, 0};
+		int ready = poll(&server_poll, 1, 100);
+		if (ready < 0 && errno != EINTR)
+		{
+			perror("poll");
+			return;
+		}
+		if (ready <= 0)
+			continue;
 
-		int valread = read(sock, buffer, packet_size_curr);
+		EzCppSocket *connection = this->acceptConnection();
+		if (connection == nullptr)
+			continue;
+		std::shared_ptr<Subscriber> subscriber = std::make_shared<Subscriber>(this->publisher_queue_depth);
+		subscriber->connection.reset(connection);
+		subscriber->sender = std::thread(&EzCppSocket::subscriberSendLoop, this, std::ref(*subscriber));
 
-		for (int i = 0; i < packet_size_curr; i++)
-			data.push_back(buffer[i]);
+		std::lock_guard<std::mutex> lock(this->subscribers_mutex);
+		this->subscribers.push_back(std::move(subscriber));
+		printf("Subscriber added, %zu subscriber(s) ...\n", this->subscribers.size());
+	}
+}
 
-		if (this->debug)
+/**
+ * @brief Subscriber sender thread. Sends the queued images until the publisher
+ * stops or a write fails, then closes the queue.
+ * @param subscriber Subscriber to send to
+ */
+void EzCppSocket::subscriberSendLoop(Subscriber &subscriber)
+{
+	try
+	{
+		std::shared_ptr<const std::vector<uchar>> message;
+		while (subscriber.queue.pop(message))
 		{
-			std::cout << "\nReceiving packet no. " << packet_start_index / this->packet_size << "\n";
-			std::cout << "This packet is of size : " << packet_size_curr << "\n";
-			std::cout << "Current size of data accumulated : " << data.size() << "\n";
+			struct iovec part = {const_cast<uchar *>(message->data()), message->size()};
+			subscriber.connection->writeVectorFully(&part, 1);
+			message.reset();
 		}
-		packet_start_index += packet_size_curr;
-		usleep(this->sleep_between_packets);
 	}
+	catch (const std::exception &e)
+	{
+		printf("Subscriber sender stopped : %s\n", e.what());
+	}
+	subscriber.queue.close();
+}
 
-	std::string data_str(data.begin(), data.end());
-	this->extractTokens(data_str);
-	std::vector<char> img_data(data_str.begin(), data_str.end());
+#ifdef EZCPPSOCKET_COROUTINES
+/**
+ * @brief Construct an async wrapper around a connected socket. SOCK_DGRAM
+ * sockets are rejected, since a frame is reassembled from datagrams with
+ * blocking reads.
+ * @param socket Socket to drive (must outlive the wrapper)
+ * @param loop Event loop driving the calls (must outlive the pending calls)
+ */
+EzAsyncSocket::EzAsyncSocket(EzCppSocket &socket, EzEventLoop &loop)
+	: connection(&socket), loop(&loop)
+{
+	if (socket.socket_type == SOCK_DGRAM)
+	{
+		std::cout << "The async methods are not supported with SOCK_DGRAM! Use the blocking read and send methods.\n";
+		throw std::runtime_error("Async methods need a connected socket");
+	}
+}
 
-	cv::Mat frame;
-	frame = cv::imdecode(cv::Mat(img_data), 1);
+/**
+ * @brief Construct an async wrapper that owns its socket
+ * @param socket Socket to drive
+ * @param loop Event loop driving the calls (must outlive the pending calls)
+ */
+EzAsyncSocket::EzAsyncSocket(std::unique_ptr<EzCppSocket> socket, EzEventLoop &loop)
+	: EzAsyncSocket(*socket, loop)
+{
+	this->owned_connection = std::move(socket);
+}
 
-	if (this->debug)
+/**
+ * @brief Awaitable readFully. Reads whatever is available without blocking and
+ * suspends until the socket is readable again.
+ * @param buffer Buffer to read into (at least size bytes)
+ * @param size Number of bytes to read
+ */
+EzTask<void> EzAsyncSocket::readFully(void *buffer, size_t size)
+{
+	uchar *ptr = static_cast<uchar *>(buffer);
+	size_t received = 0;
+	while (received < size)
 	{
-		std::cout << "Received the frame\n";
-		cv::imwrite("received.jpg", frame);
+		ssize_t valread = this->connection->receiveSome(ptr + received, size - received, MSG_DONTWAIT);
+		if (valread > 0)
+			received += valread;
+		else if (valread < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			co_await this->loop->readable(this->connection->sock);
+		else if (valread < 0 && errno == EINTR)
+			continue;
+		else
+		{
+			if (valread == 0)
+				printf("\nConnection closed by peer while reading.\n");
+			else
+				perror("Read failed");
+			throw std::runtime_error("Reading from socket failed");
+		}
 	}
-	return frame;
 }
 
-// Outgoing
 /**
- * @brief Send bool value
- * 
- * @param data Bool value to be sent
+ * @brief Awaitable writeVectorFully. Writes as much as the socket accepts
+ * without blocking and suspends until it is writable again.
+ * sleep_between_packets only limits the size of each write, no delay is added.
+ * @param message Buffers to be sent, in order
  */
-void EzCppSocket::sendBool(bool data)
+EzTask<void> EzAsyncSocket::writeVectorFully(std::vector<struct iovec> message)
 {
-	this->sendString(bool(data) ? "true" : "false");
+	struct iovec *iov = message.data();
+	size_t iovcnt = message.size();
+	while (iovcnt > 0)
+	{
+		if (iov->iov_len == 0)
+		{
+			iov++;
+			iovcnt--;
+			continue;
+		}
+
+		size_t clipped_index, clipped_len;
+		struct msghdr msg = {};
+		msg.msg_iov = iov;
+		msg.msg_iovlen = this->connection->clipToPacket(iov, std::min<size_t>(iovcnt, IOV_MAX), clipped_index, clipped_len);
+		ssize_t valsent = sendmsg(this->connection->sock, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (clipped_index < msg.msg_iovlen)
+			iov[clipped_index].iov_len = clipped_len;
+		if (valsent < 0)
+		{
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				co_await this->loop->writable(this->connection->sock);
+			else if (errno != EINTR)
+			{
+				perror("Send failed");
+				throw std::runtime_error("Writing to socket failed");
+			}
+			continue;
+		}
+
+		// Advance past the bytes that were sent
+		size_t remaining = valsent;
+		while (remaining > 0)
+		{
+			size_t step = std::min(remaining, iov->iov_len);
+			iov->iov_base = static_cast<uchar *>(iov->iov_base) + step;
+			iov->iov_len -= step;
+			remaining -= step;
+			if (iov->iov_len == 0)
+			{
+				iov++;
+				iovcnt--;
+			}
+		}
+	}
 }
 
 /**
- * @brief Send string
- * 
- * @param msg String to be sent
+ * @brief Awaitable readPayload
+ * @param expected_type Type of message the caller wants to read
+ * @param payload_size Set to the size of the payload (without tokens)
+ * @return const uchar* Start of the payload in the receive buffer (null terminated)
  */
-void EzCppSocket::sendString(std::string msg)
+EzTask<const uchar *> EzAsyncSocket::readPayload(EzCppSocket::MessageType expected_type, size_t &payload_size)
 {
-	this->insertTokens(msg);
-	const int buffer_size = msg.size();
-	this->sendInt(buffer_size);
-	const char *msg_ptr = msg.c_str();
+	EzCppSocket &socket = *this->connection;
+	const size_t header_size = socket.headerSize();
+	uchar *header = socket.reserveReceiveBuffer(header_size);
+	co_await this->readFully(header, header_size);
+	const size_t message_size = socket.parseHeader(header, expected_type);
 
-	if (this->debug)
+	uchar *buffer = socket.reserveReceiveBuffer(message_size);
+	co_await this->readFully(buffer, message_size);
+	if (socket.received_flags & (EzCppSocket::FLAG_LZ4 | EzCppSocket::FLAG_ZSTD))
 	{
-		std::cout << "Message sent length : " << strlen(msg_ptr) << "\n";
-		std::cout << "Sending message : " << msg << "\n";
+		const size_t size = socket.decompress(buffer, message_size);
+		co_return socket.extractPayload(socket.inflate_buffer.data(), size, payload_size);
+	}
+	co_return socket.extractPayload(buffer, message_size, payload_size);
+}
+
+/**
+ * @brief Awaitable sendFrame
+ * @param type Type of message being sent
+ * @param payload Buffers that make up the payload, in order
+ * @param flags Frame flags (binary framing only)
+ * @param codec Image codec (binary framing only)
+ */
+EzTask<void> EzAsyncSocket::sendFrame(EzCppSocket::MessageType type, std::vector<struct iovec> payload, uint8_t flags, uint8_t codec)
+{
+	uchar header[EzCppSocket::frame_header_size];
+	std::string size_message;
+	co_await this->writeVectorFully(this->connection->buildFrame(type, payload, flags, codec, header, size_message));
+}
+
+/**
+ * @brief Wait for a client of a multi-client server (client_connection_count > 1)
+ * without blocking the event loop.
+ * @return std::unique_ptr<EzAsyncSocket> Async wrapper owning the new connection,
+ * driven by the same loop
+ */
+EzTask<std::unique_ptr<EzAsyncSocket>> EzAsyncSocket::accept()
+{
+	while (true)
+	{
+		co_await this->loop->readable(this->connection->fd);
+		EzCppSocket *connection = this->connection->acceptConnection();
+		if (connection != nullptr)
+			co_return std::unique_ptr<EzAsyncSocket>(new EzAsyncSocket(std::unique_ptr<EzCppSocket>(connection), *this->loop));
 	}
+}
 
-	send(this->sock, msg_ptr, strlen(msg_ptr), 0);
+/**
+ * @brief Awaitable readString
+ * @return std::string Received string
+ */
+EzTask<std::string> EzAsyncSocket::readString()
+{
+	size_t payload_size;
+	const uchar *payload = co_await this->readPayload(EzCppSocket::MSG_STRING, payload_size);
+	co_return std::string(payload, payload + payload_size);
 }
 
 /**
- * @brief Send int
- * 
- * @param data Int to be sent
+ * @brief Awaitable sendString
+ * @param msg String to be sent
  */
-void EzCppSocket::sendInt(int data)
+EzTask<void> EzAsyncSocket::sendString(std::string msg)
 {
-	std::string int_str = std::to_string(data);
-	std::string int_message =
-		std::string(16 - int_str.length(), '0') + int_str;
-	this->insertTokens(int_message);
+	std::vector<struct iovec> payload = {{&msg[0], msg.length()}};
+	co_await this->sendFrame(EzCppSocket::MSG_STRING, std::move(payload));
+}
 
-	if (this->debug)
+/**
+ * @brief Awaitable readImage
+ * @return cv::Mat Received image
+ */
+EzTask<cv::Mat> EzAsyncSocket::readImage()
+{
+	size_t payload_size;
+	const uchar *payload = co_await this->readPayload(EzCppSocket::MSG_IMAGE, payload_size);
+	co_return this->connection->decodeImage(payload, payload_size);
+}
+
+/**
+ * @brief Awaitable sendImage. Only one send may be pending per socket, as the
+ * encode buffer is shared.
+ * @param img Image to be sent
+ */
+EzTask<void> EzAsyncSocket::sendImage(cv::Mat img)
+{
+	uchar mat_header[EzCppSocket::mat_header_size];
+	uint8_t flags;
+	std::vector<struct iovec> payload = this->connection->encodeImage(img, mat_header, flags);
+	co_await this->sendFrame(EzCppSocket::MSG_IMAGE, std::move(payload), flags, this->connection->image_codec);
+}
+
+/**
+ * @brief Construct a new event loop
+ */
+EzEventLoop::EzEventLoop()
+{
+	this->epoll_fd = epoll_create1(0);
+	if (this->epoll_fd < 0)
 	{
-		std::cout << "Message sent length : " << int_message.length() << "\n";
-		std::cout << "Sending message : " << int_message << "\n";
+		perror("epoll_create1");
+		exit(EXIT_FAILURE);
 	}
+}
 
-	send(this->sock, int_message.c_str(), this->tokens.first.length() + 16 + this->tokens.second.length(), 0);
+EzEventLoop::~EzEventLoop()
+{
+	this->tasks.clear();
+	close(this->epoll_fd);
 }
 
 /**
- * @brief Send float
- * 
- * @param data Float value to be sent
+ * @brief Start a task that is not awaited by any other coroutine. It runs until
+ * its first wait right away and is driven by run from then on.
+ * @param task Task to run
  */
-void EzCppSocket::sendFloat(float data)
+void EzEventLoop::spawn(EzTask<void> task)
 {
-	std::string float_str = std::to_string(data);
-	std::string float_message =
-		std::string(16 - float_str.length(), '0') + float_str;
-	this->insertTokens(float_message);
+	this->tasks.push_back(std::move(task));
+	this->tasks.back().start();
+}
 
-	if (this->debug)
+/**
+ * @brief Run until every spawned task has finished. An exception that escapes a
+ * spawned task is rethrown here (the other tasks are kept and run can be called again).
+ */
+void EzEventLoop::run()
+{
+	std::vector<struct epoll_event> events(64);
+	while (true)
 	{
-		std::cout << "Message sent length : " << float_message.length() << "\n";
-		std::cout << "Sending message : " << float_message << "\n";
+		for (auto task = this->tasks.begin(); task != this->tasks.end();)
+		{
+			if (!task->done())
+			{
+				++task;
+				continue;
+			}
+			EzTask<void> finished = std::move(*task);
+			task = this->tasks.erase(task);
+			finished.result();
+		}
+		if (this->tasks.empty())
+			return;
+		if (this->watches.empty())
+			throw std::runtime_error("EzEventLoop tasks are suspended without waiting on a socket");
+
+		int ready = epoll_wait(this->epoll_fd, events.data(), events.size(), -1);
+		if (ready < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			perror("epoll_wait");
+			throw std::runtime_error("Waiting for socket events failed");
+		}
+
+		for (int i = 0; i < ready; i++)
+		{
+			auto watch = this->watches.find(events[i].data.fd);
+			if (watch == this->watches.end())
+				continue;
+
+			// Errors wake both sides, the following recv/send reports them
+			std::coroutine_handle<> reader, writer;
+			if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+				reader = std::exchange(watch->second.reader, nullptr);
+			if (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+				writer = std::exchange(watch->second.writer, nullptr);
+			this->updateWatch(events[i].data.fd, true);
+
+			if (reader)
+				reader.resume();
+			if (writer)
+				writer.resume();
+		}
 	}
+}
 
-	send(this->sock, float_message.c_str(), this->tokens.first.length() + 16 + this->tokens.second.length(), 0);
+/**
+ * @brief Resume handle once fd becomes readable (or writable)
+ */
+void EzEventLoop::watch(int fd, bool write, std::coroutine_handle<> handle)
+{
+	auto watch = this->watches.find(fd);
+	const bool registered = watch != this->watches.end();
+	Watch &waiting = this->watches[fd];
+	(write ? waiting.writer : waiting.reader) = handle;
+	this->updateWatch(fd, registered);
 }
 
 /**
- * @brief Send vector of ints
+ * @brief Make the epoll interest of fd match the coroutines waiting on it
+ * @param registered Whether fd is currently registered with epoll
+ */
+void EzEventLoop::updateWatch(int fd, bool registered)
+{
+	Watch &waiting = this->watches[fd];
+	struct epoll_event event = {};
+	event.data.fd = fd;
+	if (waiting.reader)
+		event.events |= EPOLLIN;
+	if (waiting.writer)
+		event.events |= EPOLLOUT;
+
+	if (event.events == 0)
+	{
+		epoll_ctl(this->epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+		this->watches.erase(fd);
+	}
+	else if (epoll_ctl(this->epoll_fd, registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event) < 0)
+	{
+		perror("epoll_ctl");
+		throw std::runtime_error("Watching socket failed");
+	}
+}
+#endif
+
+/**
+ * @brief Construct a new thread pool
  * 
- * @param data Vector of ints to be sent
+ * @param thread_count Number of worker threads to start (at least 1)
  */
-void EzCppSocket::sendIntList(std::vector<int> data)
+EzThreadPool::EzThreadPool(unsigned int thread_count)
 {
-	std::string int_list;
-	int_list += "[";
-	for (auto val : data)
-		int_list.append(std::to_string(val) + ",");
+	thread_count = std::max(thread_count, 1u);
+	for (unsigned int i = 0; i < thread_count; i++)
+		this->workers.emplace_back(&EzThreadPool::workerLoop, this);
+}
 
-	// remove the extra comma and add a closing bracket
-	int_list.substr(0, int_list.length() - 2);
-	int_list += "]";
-	this->sendString(int_list);
+/**
+ * @brief Finish the queued tasks and join the worker threads
+ */
+EzThreadPool::~EzThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stopping = true;
+	}
+	this->task_available.notify_all();
+	for (auto &worker : this->workers)
+		worker.join();
 }
 
 /**
- * @brief Send vector of floats
+ * @brief Queue a task to be run by one of the workers
  * 
- * @param data Vector of floats to be sent
+ * @param task Task to run
  */
-void EzCppSocket::sendFloatList(std::vector<float> data)
+void EzThreadPool::submit(std::function<void()> task)
 {
-	std::string float_list;
-	float_list += "[";
-	for (auto val : data)
 	{
-		float_list.append(std::to_string(val) + ",");
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->tasks.push(std::move(task));
 	}
-	// remove the extra comma and add a closing bracket
-	float_list.substr(0, float_list.length() - 2);
-	float_list += "]";
-	this->sendString(float_list);
+	this->task_available.notify_one();
 }
 
 /**
- * @brief Send Image
+ * @brief Run task(0) ... task(count - 1) on the workers and block until they
+ * have finished. Unlike wait, only these tasks are waited for, so several
+ * threads may run batches on the same pool at once.
  * 
- * @param img Image to be sent
+ * @param count Number of runs
+ * @param task Task to run, given the index of the run
  */
-void EzCppSocket::sendImage(cv::Mat img)
+void EzThreadPool::run(size_t count, const std::function<void(size_t)> &task)
 {
-	int pixel_number = img.rows * img.cols / 2;
+	std::mutex done_mutex;
+	std::condition_variable done;
+	size_t remaining = count;
+	for (size_t i = 0; i < count; i++)
+		this->submit([&, i] {
+			task(i);
+			std::lock_guard<std::mutex> lock(done_mutex);
+			if (--remaining == 0)
+				done.notify_all();
+		});
 
-	std::vector<uchar> buf(pixel_number);
-	cv::imencode(".jpg", img, buf);
+	std::unique_lock<std::mutex> lock(done_mutex);
+	done.wait(lock, [&] { return remaining == 0; });
+}
 
-	// Token handling
-	std::string buf_str(buf.begin(), buf.end());
-	this->insertTokens(buf_str);
-	buf = std::vector<uchar>(buf_str.begin(), buf_str.end());
+/**
+ * @brief Block until every submitted task has finished
+ */
+void EzThreadPool::wait()
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+	this->idle.wait(lock, [this] { return this->tasks.empty() && this->busy_count == 0; });
+}
 
-	// Send image size first
-	if (this->debug)
-		std::cout << "Total image buffer size:" << sizeof(buf) << "\n";
-	this->sendInt(buf.size());
+/**
+ * @brief Number of worker threads in the pool
+ * @return unsigned int Number of workers
+ */
+unsigned int EzThreadPool::size()
+{
+	return this->workers.size();
+}
 
-	unsigned packet_start_index = 0;
-	unsigned int packet_size_curr = this->packet_size;
-	// Break into packets of size defined by packet_size
-	while (packet_start_index < buf.size())
+/**
+ * @brief Run queued tasks until the pool is destroyed
+ */
+void EzThreadPool::workerLoop()
+{
+	while (true)
 	{
-		if ((packet_start_index + this->packet_size) > buf.size())
-			packet_size_curr = buf.size() - packet_start_index;
-
-		std::vector<uchar> buf_packet(&buf[packet_start_index], &buf[packet_start_index + packet_size_curr]);
-		if (this->debug)
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+			this->task_available.wait(lock, [this] { return this->stopping || !this->tasks.empty(); });
+			if (this->tasks.empty())
+				return;
+			task = std::move(this->tasks.front());
+			this->tasks.pop();
+			this->busy_count++;
+		}
+		task();
 		{
-			std::cout << "\nSending packet no. " << packet_start_index / this->packet_size << "\n";
-			std::cout << "This packet is of size : " << buf_packet.size() << "\n";
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->busy_count--;
+			if (this->tasks.empty() && this->busy_count == 0)
+				this->idle.notify_all();
 		}
-		send(this->sock, buf_packet.data(), buf_packet.size(), 0);
-		packet_start_index += packet_size_curr;
-		usleep(this->sleep_between_packets);
 	}
-}
\ No newline at end of file
+}
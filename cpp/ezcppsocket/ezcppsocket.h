@@ -5,6 +5,17 @@
 // Client side C/C++ program to demonstrate Socket programming
 #include <stdio.h>
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stddef.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <limits.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <string.h>
@@ -19,37 +30,744 @@
 #include <sstream>
 #include <vector>
 #include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cerrno>
+#include <stdexcept>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <queue>
+#include <deque>
+#include <atomic>
+#include <utility>
+
+// Awaitable API (asyncReadImage etc.) when compiled as C++20
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+#include <coroutine>
+#include <optional>
+#include <exception>
+#define EZCPPSOCKET_COROUTINES
+#endif
+
+// Optional payload compression (see setCompression), link with -llz4 / -lzstd
+#ifdef EZCPPSOCKET_WITH_LZ4
+#include <lz4.h>
+#endif
+#ifdef EZCPPSOCKET_WITH_ZSTD
+#include <zstd.h>
+#endif
 
 #ifndef __EZCPPSOCKET__
 #define __EZCPPSOCKET__
+/**
+ * @brief N-dimensional tensor received with readTensor
+ * 
+ * @tparam T Element type
+ */
+template <typename T>
+struct EzTensor
+{
+	std::vector<size_t> shape; // Size of each dimension (row-major)
+	std::vector<T> data;	   // Elements in row-major order
+};
+
+/**
+ * @brief Fixed size pool of worker threads running submitted tasks in FIFO order.
+ * Destroying the pool finishes the queued tasks and joins the workers.
+ */
+class EzThreadPool
+{
+public:
+	explicit EzThreadPool(unsigned int thread_count);
+	~EzThreadPool();
+	void submit(std::function<void()> task);
+	void run(size_t count, const std::function<void(size_t)> &task);
+	void wait();
+	unsigned int size();
+
+private:
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable task_available;
+	std::condition_variable idle;
+	unsigned int busy_count = 0;
+	bool stopping = false;
+
+	void workerLoop();
+};
+
+/**
+ * @brief Lock-free single producer, single consumer ring buffer.
+ * Exactly one thread may push and exactly one (other) thread may pop.
+ * 
+ * @tparam T Element type
+ */
+template <typename T>
+class EzSpscQueue
+{
+public:
+	explicit EzSpscQueue(size_t capacity) : slots(capacity + 1) {}
+
+	/**
+	 * @brief Add an item to the queue (producer thread only)
+	 * @return false Queue is full, item was not added
+	 */
+	bool tryPush(T item)
+	{
+		const size_t current_tail = this->tail.load(std::memory_order_relaxed);
+		const size_t next_tail = (current_tail + 1) % this->slots.size();
+		if (next_tail == this->head.load(std::memory_order_acquire))
+			return false;
+		this->slots[current_tail] = std::move(item);
+		this->tail.store(next_tail, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * @brief Take the oldest item from the queue (consumer thread only)
+	 * @return false Queue is empty, item is untouched
+	 */
+	bool tryPop(T &item)
+	{
+		const size_t current_head = this->head.load(std::memory_order_relaxed);
+		if (current_head == this->tail.load(std::memory_order_acquire))
+			return false;
+		item = std::move(this->slots[current_head]);
+		this->slots[current_head] = T(); // Release resources held by the slot
+		this->head.store((current_head + 1) % this->slots.size(), std::memory_order_release);
+		return true;
+	}
+
+	bool empty() const
+	{
+		return this->head.load(std::memory_order_acquire) == this->tail.load(std::memory_order_acquire);
+	}
+
+private:
+	std::vector<T> slots;
+	alignas(64) std::atomic<size_t> head{0}; // Next slot to pop (written by consumer)
+	alignas(64) std::atomic<size_t> tail{0}; // Next slot to push (written by producer)
+};
+
+/**
+ * @brief Bounded multi-producer, multi-consumer queue guarded by a mutex.
+ * When full, producers either wait for room, give up on the new item or evict
+ * the oldest one. Closing the queue wakes everyone: pushes then fail, and pops
+ * return the remaining items before failing.
+ * 
+ * @tparam T Element type
+ */
+template <typename T>
+class EzBoundedQueue
+{
+public:
+	explicit EzBoundedQueue(size_t capacity) : capacity(std::max(capacity, (size_t)1)) {}
+
+	/**
+	 * @brief Add an item, waiting for room while the queue is full
+	 * @return false Queue was closed, item was not added
+	 */
+	bool push(T item)
+	{
+		std::unique_lock<std::mutex> lock(this->mutex);
+		this->not_full.wait(lock, [&] { return this->closed || this->items.size() < this->capacity; });
+		if (this->closed)
+			return false;
+		this->items.push_back(std::move(item));
+		this->not_empty.notify_one();
+		return true;
+	}
+
+	/**
+	 * @brief Add an item if there is room
+	 * @return false Queue is full or closed, item was not added
+	 */
+	bool tryPush(T item)
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		if (this->closed || this->items.size() >= this->capacity)
+			return false;
+		this->items.push_back(std::move(item));
+		this->not_empty.notify_one();
+		return true;
+	}
+
+	/**
+	 * @brief Add an item, dropping the oldest one if the queue is full
+	 * @return true The oldest item was dropped to make room
+	 */
+	bool pushDropOldest(T item)
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		if (this->closed)
+			return false;
+		const bool dropped = this->items.size() >= this->capacity;
+		if (dropped)
+			this->items.pop_front();
+		this->items.push_back(std::move(item));
+		this->not_empty.notify_one();
+		return dropped;
+	}
+
+	/**
+	 * @brief Take the oldest item, waiting while the queue is empty
+	 * @return false Queue is closed and empty, item is untouched
+	 */
+	bool pop(T &item)
+	{
+		std::unique_lock<std::mutex> lock(this->mutex);
+		this->not_empty.wait(lock, [&] { return this->closed || !this->items.empty(); });
+		if (this->items.empty())
+			return false;
+		item = std::move(this->items.front());
+		this->items.pop_front();
+		this->not_full.notify_one();
+		return true;
+	}
+
+	void close()
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->closed = true;
+		this->not_empty.notify_all();
+		this->not_full.notify_all();
+	}
+
+	bool isClosed()
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		return this->closed;
+	}
+
+private:
+	const size_t capacity;
+	std::deque<T> items;
+	std::mutex mutex;
+	std::condition_variable not_empty;
+	std::condition_variable not_full;
+	bool closed = false;
+};
+
+#ifdef EZCPPSOCKET_COROUTINES
+/**
+ * @brief State shared by all EzTask promises: the coroutine to resume when the
+ * task finishes and the exception it finished with.
+ */
+struct EzTaskPromiseBase
+{
+	std::coroutine_handle<> continuation;
+	std::exception_ptr exception;
+
+	struct FinalAwaiter
+	{
+		bool await_ready() noexcept { return false; }
+		template <typename Promise>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+		{
+			std::coroutine_handle<> continuation = handle.promise().continuation;
+			return continuation ? continuation : std::noop_coroutine();
+		}
+		void await_resume() noexcept {}
+	};
+
+	std::suspend_always initial_suspend() noexcept { return {}; }
+	FinalAwaiter final_suspend() noexcept { return {}; }
+	void unhandled_exception() { this->exception = std::current_exception(); }
+};
+
+template <typename T>
+struct EzTaskPromise : EzTaskPromiseBase
+{
+	std::optional<T> value;
+
+	void return_value(T result) { this->value.emplace(std::move(result)); }
+	T result()
+	{
+		if (this->exception)
+			std::rethrow_exception(this->exception);
+		return std::move(*this->value);
+	}
+};
+
+template <>
+struct EzTaskPromise<void> : EzTaskPromiseBase
+{
+	void return_void() {}
+	void result()
+	{
+		if (this->exception)
+			std::rethrow_exception(this->exception);
+	}
+};
+
+/**
+ * @brief Lazily started coroutine returned by the async methods of EzCppSocket.
+ * The task runs when it is co_awaited (or spawned on an EzEventLoop), and
+ * co_await returns its result or rethrows its exception.
+ * 
+ * @tparam T Result type
+ */
+template <typename T = void>
+class EzTask
+{
+public:
+	struct promise_type : EzTaskPromise<T>
+	{
+		EzTask get_return_object() { return EzTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+	};
+
+	EzTask(EzTask &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+	EzTask &operator=(EzTask &&other) noexcept
+	{
+		if (this != &other)
+		{
+			if (this->handle)
+				this->handle.destroy();
+			this->handle = std::exchange(other.handle, nullptr);
+		}
+		return *this;
+	}
+	~EzTask()
+	{
+		if (this->handle)
+			this->handle.destroy();
+	}
+
+	bool await_ready() const noexcept { return this->done(); }
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+	{
+		this->handle.promise().continuation = caller;
+		return this->handle;
+	}
+	T await_resume() { return this->handle.promise().result(); }
+
+	// Used to drive a task that nobody awaits (EzEventLoop::spawn)
+	void start() { this->handle.resume(); }
+	bool done() const noexcept { return !this->handle || this->handle.done(); }
+	T result() { return this->handle.promise().result(); }
+
+private:
+	explicit EzTask(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+	std::coroutine_handle<promise_type> handle;
+};
+
+/**
+ * @brief Single threaded epoll event loop that resumes EzTask coroutines when
+ * the socket they wait on becomes readable or writable. One loop can drive the
+ * exchanges of many sockets at once.
+ */
+class EzEventLoop
+{
+public:
+	struct IoAwaiter
+	{
+		EzEventLoop *loop;
+		int fd;
+		bool write;
+
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> handle) { this->loop->watch(this->fd, this->write, handle); }
+		void await_resume() const noexcept {}
+	};
+
+	EzEventLoop();
+	~EzEventLoop();
+	void spawn(EzTask<void> task);
+	void run();
+	IoAwaiter readable(int fd) { return {this, fd, false}; }
+	IoAwaiter writable(int fd) { return {this, fd, true}; }
+
+private:
+	// Coroutines waiting on a file descriptor (at most one reader and one writer)
+	struct Watch
+	{
+		std::coroutine_handle<> reader;
+		std::coroutine_handle<> writer;
+	};
+
+	int epoll_fd;
+	std::map<int, Watch> watches;
+	std::vector<EzTask<void>> tasks;
+
+	void watch(int fd, bool write, std::coroutine_handle<> handle);
+	void updateWatch(int fd, bool registered);
+};
+#endif
+
+/**
+ * @brief Mapping of a shared memory ring of frame slots (see setSharedMemory)
+ */
+struct EzSharedMemoryRing
+{
+	std::string name;		  // POSIX shared memory name
+	uchar *base = nullptr;	  // Start of the mapping
+	size_t mapped_size = 0;	  // Size of the mapping
+	unsigned int slot_count = 0;
+	size_t slot_size = 0;	  // Bytes per slot
+	size_t data_offset = 0;	  // Offset of slot 0 from base
+	unsigned int next_slot = 0; // Next slot to write (sending side)
+};
+
+/**
+ * @brief Message being reassembled from its datagrams (SOCK_DGRAM)
+ */
+struct EzDatagramFrame
+{
+	bool active = false;
+	uint32_t id = 0;				// Frame id given by the sender
+	std::vector<uchar> data;		// Message bytes (frame size)
+	std::vector<bool> received;		// Fragments received so far, by index
+	size_t fragments_left = 0;		// Fragments still missing
+	size_t bytes_received = 0;		// Bytes received so far, must add up to the frame size
+};
+
 /**
  * @brief Python - Cpp Communication Server Object
  * 
  */
 class EzCppSocket
 {
+public:
+	// Type tags carried in the binary frame header
+	enum MessageType : uint8_t
+	{
+		MSG_STRING = 1,
+		MSG_INT = 2,
+		MSG_FLOAT = 3,
+		MSG_INT_LIST = 4,
+		MSG_FLOAT_LIST = 5,
+		MSG_IMAGE = 6,
+		MSG_MAT = 7,
+		MSG_TENSOR = 8,
+		MSG_CONTROL = 9,
+		MSG_SHM_MAT = 10,
+		MSG_SHM_ATTACH = 11,
+		MSG_IMAGE_BATCH = 12
+	};
+
+	// Codes carried by MSG_CONTROL messages (1 byte payload)
+	enum ControlCode : uint8_t
+	{
+		CONTROL_LOOP_STOP = 1
+	};
+
+	// Codecs sendImage can encode with (see setImageCodec)
+	enum ImageCodec : uint8_t
+	{
+		CODEC_JPEG = 0,
+		CODEC_PNG = 1,
+		CODEC_WEBP = 2,
+		CODEC_RAW = 3 // Mat header and pixel data as sent by sendMat, no encoding
+	};
+
+	// Bits of the frame header flags
+	enum FrameFlag : uint8_t
+	{
+		FLAG_KEEP_CHANNELS = 1, // Decode the image with its own channels and depth (IMREAD_UNCHANGED)
+		FLAG_LZ4 = 2,			// Message is LZ4 compressed
+		FLAG_ZSTD = 4,			// Message is zstd compressed
+		FLAG_TILED = 8,			// Image is split into stripes encoded on their own (see setImageTiles)
+		FLAG_DELTA = 16,		// Image carries only the tiles that changed since the last one (see setDeltaImages)
+		FLAG_KEYFRAME = 32		// Whole image that following delta images are patched into
+	};
+
+	// Called with the image being filled in, the first row and the number of rows
+	// of each stripe decoded by a streaming readImage (see setStreamingImages)
+	typedef std::function<void(const cv::Mat &frame, int first_row, int row_count)> TileCallback;
+
+	// What a full outbound queue does with a new image (see startDuplex, startPublisher)
+	enum OverflowPolicy : uint8_t
+	{
+		OVERFLOW_BLOCK = 0,		  // Wait until there is room
+		OVERFLOW_DROP_OLDEST = 1, // Drop the oldest queued image, so the freshest ones are sent
+		OVERFLOW_DROP_NEWEST = 2  // Drop the new image
+	};
+
+	// Payload compression methods (see setCompression)
+	enum Compression : uint8_t
+	{
+		COMPRESSION_NONE = 0,
+		COMPRESSION_LZ4 = 1,
+		COMPRESSION_ZSTD = 2
+	};
+
+	// Element types carried in binary list headers
+	enum DataType : uint8_t
+	{
+		DTYPE_UINT8 = 1,
+		DTYPE_INT8 = 2,
+		DTYPE_UINT16 = 3,
+		DTYPE_INT16 = 4,
+		DTYPE_INT32 = 5,
+		DTYPE_INT64 = 6,
+		DTYPE_FLOAT32 = 7,
+		DTYPE_FLOAT64 = 8
+	};
+
+	// Binary frame header layout (little-endian):
+	// [uint32 payload size][uint8 message type][uint8 flags][uint8 image codec][uint8 reserved]
+	static const unsigned int frame_header_size = 8;
+
+	// Raw cv::Mat header layout (little-endian), followed by rows * step bytes of pixel data:
+	// [uint32 rows][uint32 cols][uint32 cv type][uint32 step (bytes per row)]
+	static const unsigned int mat_header_size = 16;
+
+	// Binary list header layout (little-endian), followed by count elements in host byte order:
+	// [uint8 data type][uint8 x3 reserved][uint32 element count]
+	static const unsigned int list_header_size = 8;
+
+	// Tensor header layout (little-endian), followed by the elements in row-major order:
+	// [uint8 data type][uint8 number of dimensions][uint16 reserved][uint32 size of each dimension ...]
+	static const unsigned int tensor_header_size = 4;
+
+	// Tiled image payload layout (FLAG_TILED, little-endian), followed by the encoded stripes in order:
+	// [uint32 rows][uint32 cols][uint32 tile count][per tile: uint32 rows of the stripe, uint32 encoded size]
+	static const unsigned int tiled_header_size = 12;
+	static const unsigned int tile_entry_size = 8;
+
+	// Delta image payload layout (FLAG_DELTA, little-endian), followed by the encoded tiles in order:
+	// [uint32 rows][uint32 cols][uint32 tile count][per tile: uint32 x, uint32 y, uint32 encoded size]
+	static const unsigned int delta_header_size = 12;
+	static const unsigned int delta_entry_size = 12;
+
+	// Image batch payload layout (MSG_IMAGE_BATCH, little-endian), followed by the images in order,
+	// each encoded like a sendImage payload with the codec of the frame header:
+	// [uint32 image count][per image: uint32 encoded size]
+	static const unsigned int batch_header_size = 4;
+	static const unsigned int batch_entry_size = 4;
+
+	// Compressed message layout (FLAG_LZ4/FLAG_ZSTD), replacing tokens and payload:
+	// [uint32 size of the tokens and payload][compressed tokens and payload]
+	static const unsigned int compression_header_size = 4;
+
+	// With SOCK_SEQPACKET (AF_UNIX), the byte stream is carried in records of at most this size
+	static const size_t seqpacket_record_size = 65536;
+
+	// With SOCK_DGRAM, every message is sent as one frame split into datagrams of at most
+	// datagram_size bytes, each starting with this header (little-endian):
+	// [uint32 frame id][uint32 frame size][uint32 fragment offset][uint16 fragment index][uint16 fragment count]
+	static const unsigned int datagram_header_size = 16;
+	// Largest UDP payload (IPv4)
+	static const unsigned int max_datagram_size = 65507;
+	// Frames reassembled at the same time, the oldest is dropped when a newer one needs the slot
+	static const unsigned int datagram_reassembly_slots = 4;
+
+	// Shared memory ring layout: [ring header][slot states][slots]
+	// Ring header: [uint32 magic][uint32 slot count][uint64 slot size], padded to shm_header_size
+	// Slot states: one uint32 (SHM_SLOT_FREE/SHM_SLOT_READY) per slot, each on its own cache line
+	// Slots: slot count * slot size bytes, starting at a page boundary
+	static const unsigned int shm_header_size = 64;
+	static const unsigned int shm_state_stride = 64;
+	static const uint32_t shm_magic = 0x4D535A45; // "EZSM"
+	enum SharedSlotState : uint32_t
+	{
+		SHM_SLOT_FREE = 0,
+		SHM_SLOT_READY = 1
+	};
+
+	// MSG_SHM_ATTACH payload (little-endian): [uint32 slot count][uint32 reserved][uint64 slot size][shm name]
+	static const unsigned int shm_attach_header_size = 16;
+	// MSG_SHM_MAT payload (little-endian): [uint32 slot][Mat header (see mat_header_size)]
+	static const unsigned int shm_mat_header_size = 4 + mat_header_size;
+
 private:
-	int sock;									// Socket point 
-	int fd;										// File descriptor (Server)
+	// The async API (C++20) drives the socket from outside, so this class is the
+	// same whatever standard it is compiled with
+	friend class EzAsyncSocket;
+
+	int sock = -1;								// Socket point 
+	int fd = -1;								// File descriptor (Server)
 	std::string server_address;					// Server address
 	int server_port;							// Port number
 	int socket_family;							// IPV4/IPV6
 	int socket_type;							// TCP/UDP
 	bool debug;									// Debug flag
-	struct sockaddr_in serv_addr;				// Address struct
+	struct sockaddr_storage serv_addr;			// Address struct (sockaddr_in, sockaddr_in6 or sockaddr_un)
+	socklen_t serv_addr_len = 0;				// Size of the address in serv_addr
 	int client_connection_count;				// No. of client connections our server should accept
 	float reconnect_on_address_busy;			// No. of seconds timeout before polling again in case of errors raised
 	std::pair<std::string, std::string> tokens; // Pair of tokens (start_token, end_token)
-	unsigned int sleep_between_packets = 50;	// No. of useconds between reading/sending packets of data
+	unsigned int sleep_between_packets = 0;		// No. of useconds between reading/sending packets of data
 	unsigned int packet_size = 59625;			// No. of bytes in a packet read/write (Should not be more than 65535 (64K))
+	size_t rate_limit = 0;						// Outgoing bytes per second (0 is unlimited)
+	size_t rate_burst = 0;						// Token bucket size, the most bytes sent at once
+	double rate_tokens = 0;						// Bytes that may be sent right now (negative while paying back)
+	std::chrono::steady_clock::time_point rate_refill_time; // Last time rate_tokens was refilled
+	bool binary_framing = false;				// Use binary frame headers instead of 16 digit ASCII size headers
+	bool binary_lists = false;					// Send int/float lists as raw contiguous elements instead of text
+	bool loop_stop_message = false;				// Loops with loop_count 0 end with one stop message instead of a status string per iteration
+	std::vector<uchar> recv_buffer;				// Receive buffer reused across messages (grows to the largest message)
+	EzSharedMemoryRing shm_outbound;			// Ring created by this end, written by sendMat
+	EzSharedMemoryRing shm_inbound;				// Ring created by the peer, read by readMat
+	bool shm_attach_sent = false;				// Whether the peer was told about shm_outbound
+	int shm_held_slot = -1;						// Inbound slot backing the last Mat returned by readMat
+	std::vector<uchar> record_buffer;			// SOCK_SEQPACKET bytes received but not read yet
+	size_t record_begin = 0;					// Start of the unread bytes in record_buffer
+	size_t record_end = 0;						// End of the unread bytes in record_buffer
+	unsigned int datagram_size = 1400;			// Bytes per datagram, fits a 1500 byte Ethernet MTU (SOCK_DGRAM)
+	unsigned int datagram_timeout = 0;			// Milliseconds to wait for a complete frame (0 waits forever)
+	uint32_t next_datagram_frame = 0;			// Id of the next frame sent
+	uint32_t last_datagram_frame = 0;			// Id of the last frame delivered
+	bool datagram_frame_delivered = false;		// Whether last_datagram_frame is set
+	unsigned long dropped_frame_count = 0;		// Frames skipped because they were lost, late or incomplete
+	std::vector<EzDatagramFrame> datagram_frames; // Frames being reassembled
+	std::vector<uchar> datagram_buffer;			// Single datagram receive buffer
+	size_t max_message_size = 1 << 30;			// Largest message accepted from the peer (1 GiB)
+	unsigned int worker_threads = 1;			// Threads running serverLoop callbacks of a multi-client server
+	std::vector<uchar> encode_buffer;			// Encoded image buffer reused across sendImage calls
+	ImageCodec image_codec = CODEC_JPEG;		// Codec used by sendImage
+	int image_quality = -1;						// Codec quality/compression level (-1 uses the OpenCV default)
+	bool keep_channels = false;					// Whether the peer decodes images with their own channels
+	unsigned int image_tiles = 1;				// Stripes sendImage splits images into (1 sends whole images)
+	unsigned int tile_threads = 0;				// Threads encoding/decoding stripes (0 uses one per core)
+	std::shared_ptr<EzThreadPool> tile_pool;	// Started by the first tiled image
+	std::mutex tile_pool_mutex;					// Guards tile_pool (duplex reads and writes share it)
+	std::vector<uchar> tile_table;				// Tiled image header and tile table of the last sendImage
+	std::vector<std::vector<uchar>> tile_buffers; // Encoded stripes of the last sendImage
+	bool streaming_images = false;				// Whether readImage decodes stripes while receiving them
+	TileCallback tile_callback;					// Called for each stripe decoded by a streaming readImage
+	bool delta_images = false;					// Whether sendImage sends only the tiles that changed
+	unsigned int delta_tile_size = 64;			// Width and height of delta image tiles
+	double delta_threshold = 2.0;				// Mean absolute difference above which a tile is sent
+	unsigned int keyframe_interval = 30;		// Images between keyframes (0 only on size changes)
+	unsigned int frames_since_keyframe = 0;		// Delta images sent since the last keyframe
+	cv::Mat delta_reference;					// What the peer has of the image, updated as tiles are sent
+	cv::Mat delta_frame;						// Last keyframe with the received delta tiles patched in
+	struct BatchMatHeader
+	{
+		uchar bytes[mat_header_size];
+	};
+	std::vector<uchar> batch_table;				// Image count and size table of the last sendImages
+	std::vector<std::vector<uchar>> batch_buffers; // Encoded images of the last sendImages
+	std::vector<BatchMatHeader> batch_mat_headers; // Mat headers of the last CODEC_RAW sendImages
+	uint8_t received_flags = 0;					// Flags of the last frame header read
+	uint8_t received_codec = CODEC_JPEG;		// Image codec of the last frame header read
+	Compression compression = COMPRESSION_NONE; // Compression of outgoing payloads
+	int compression_level = 0;					// zstd compression level (0 uses the zstd default)
+	size_t compression_threshold = 1024;		// Smallest payload that gets compressed
+	std::vector<uchar> compress_input;			// Outgoing message gathered for compression
+	std::vector<uchar> compress_output;			// Compressed outgoing message
+	std::vector<uchar> inflate_input;			// Compressed incoming message
+	std::vector<uchar> inflate_buffer;			// Decompressed incoming message, read before the socket
+	size_t inflate_begin = 0;					// Start of the unread bytes in inflate_buffer
+	size_t inflate_end = 0;						// End of the unread bytes in inflate_buffer
+
+	// Duplex mode: images posted by the application are sent by duplex_writer,
+	// received images are read by duplex_reader (see startDuplex)
+	std::unique_ptr<EzBoundedQueue<cv::Mat>> duplex_outbound;
+	OverflowPolicy duplex_policy = OVERFLOW_DROP_NEWEST;
+	std::unique_ptr<EzSpscQueue<cv::Mat>> duplex_inbound;
+	std::thread duplex_reader;
+	std::thread duplex_writer;
+	std::atomic<bool> duplex_running{false};
+	std::atomic<bool> duplex_failed{false};
+	unsigned int duplex_posted_count = 0;
+	unsigned int duplex_polled_count = 0;
+
+	// Publisher mode: every subscriber connection has a bounded queue of
+	// published messages sent by its own sender thread (see startPublisher)
+	struct Subscriber
+	{
+		explicit Subscriber(size_t queue_depth) : queue(queue_depth) {}
+		std::unique_ptr<EzCppSocket> connection;
+		EzBoundedQueue<std::shared_ptr<const std::vector<uchar>>> queue; // Closed when the sender stops
+		std::thread sender;
+	};
+	std::vector<std::shared_ptr<Subscriber>> subscribers;
+	std::mutex subscribers_mutex;				// Guards subscribers, never held while pushing to a queue
+	std::thread publisher_acceptor;
+	std::atomic<bool> publisher_running{false};
+	size_t publisher_queue_depth = 1;
+	OverflowPolicy publisher_policy = OVERFLOW_DROP_OLDEST;
+	std::atomic<unsigned long> queue_dropped_count{0}; // Images dropped by full outbound queues
 
 	bool loop_flag = false;
 	unsigned int loop_iteration_count = 0;
 	std::chrono::time_point<std::chrono::high_resolution_clock> loop_start_time = std::chrono::high_resolution_clock::now();
 
 	void insertTokens(std::string &msg);
-	void extractTokens(std::string &msg);
+	bool checkTokens(const uchar *msg, size_t size);
+	void checkMessageSize(size_t size);
+	uchar *reserveReceiveBuffer(size_t size);
+	const uchar *readPayload(MessageType expected_type, size_t &payload_size);
+	const uchar *extractPayload(uchar *buffer, size_t message_size, size_t &payload_size);
+	const uchar *readMessage(size_t message_size, size_t &payload_size);
+	void readToken(const std::string &token, bool start_token);
+	static void putUint32(uchar *buffer, uint32_t value);
+	static uint32_t getUint32(const uchar *buffer);
+	static bool validMatHeader(uint32_t rows, uint32_t cols, uint32_t type, uint32_t step, size_t max_size);
+	static size_t dataTypeSize(DataType dtype);
+	size_t readListHeader(MessageType type, DataType expected_dtype);
+	void sendList(MessageType type, DataType dtype, const void *data, size_t count);
+	std::vector<size_t> readTensorHeader(DataType expected_dtype);
+	void sendTensorData(DataType dtype, const void *data, const std::vector<size_t> &shape);
+	template <typename T>
+	static DataType dataTypeOf();
 	void pollingTimeout();
+	void buildAddress();
+	void removeStaleSocketFile();
+	void printPeerAddress(const struct sockaddr_storage &peer_addr);
+	void readFully(void *buffer, size_t size);
+	ssize_t receiveSome(uchar *buffer, size_t size, int flags);
+	ssize_t receiveRecord(uchar *buffer, int flags);
+	bool hasBufferedData();
+	void configureDatagramSocket();
+	void waitForDatagramPeer();
+	void sendDatagrams(const struct iovec *iov, size_t iovcnt);
+	bool receiveDatagramFrame();
+	EzDatagramFrame *datagramFrame(uint32_t id, size_t frame_size, size_t fragment_count);
+	size_t clipToPacket(struct iovec *iov, size_t count, size_t &clipped_index, size_t &clipped_len);
+	void peekFully(void *buffer, size_t size);
+	void sendLoopStop();
+	bool readLoopStop();
+	void writeFully(const void *buffer, size_t size);
+	void paceSend(size_t bytes);
+	void writeVectorFully(struct iovec *iov, size_t iovcnt);
+	void sendFrame(MessageType type, const std::vector<struct iovec> &payload, uint8_t flags = 0, uint8_t codec = 0);
+	std::vector<struct iovec> buildFrame(MessageType type, const std::vector<struct iovec> &payload, uint8_t flags, uint8_t codec,
+										 uchar (&header)[frame_header_size], std::string &size_message);
+	uint8_t compressMessage(MessageType type, uint8_t codec, std::vector<struct iovec> &message, size_t &payload_size);
+	size_t inflateMessage(size_t message_size);
+	size_t decompress(const uchar *message, size_t message_size);
+	std::vector<struct iovec> matPayload(const cv::Mat &img, uchar (&mat_header)[mat_header_size]);
+	std::vector<struct iovec> encodeImage(const cv::Mat &img, uchar (&mat_header)[mat_header_size], uint8_t &flags,
+										  bool allow_delta = true);
+	const char *codecParams(std::vector<int> &params);
+	cv::Mat decodeImage(const uchar *payload, size_t payload_size);
+	std::vector<struct iovec> encodeTiles(const cv::Mat &img, const char *extension, const std::vector<int> &params);
+	cv::Mat decodeTiles(const uchar *payload, size_t payload_size, int read_flag);
+	size_t parseTileTable(const uchar *table, std::vector<size_t> &first_rows, std::vector<size_t> &offsets);
+	bool decodeTile(const uchar *data, size_t size, int read_flag, cv::Mat &frame, std::mutex &frame_mutex,
+					int first_row, int row_count, int cols, int rows);
+	cv::Mat readStreamingImage(size_t &payload_size);
+	std::vector<struct iovec> encodeDelta(const cv::Mat &img, const char *extension, const std::vector<int> &params);
+	cv::Mat decodeDelta(const uchar *payload, size_t payload_size, int read_flag);
+	std::shared_ptr<EzThreadPool> tilePool();
+	unsigned int readHeader(MessageType expected_type);
+	size_t headerSize();
+	unsigned int parseHeader(uchar *header, MessageType expected_type);
+	void sendMessage(MessageType type, const std::string &msg);
+
+	EzCppSocket(const EzCppSocket &server, int connection_sock);
+	EzCppSocket *acceptConnection();
+	bool serveConnection(EzCppSocket &connection, void (*func_ptr)(EzCppSocket&), int loop_count, bool show_ips);
+	void multiClientServerLoop(void (*func_ptr)(EzCppSocket&), int loop_count, bool show_ips);
+	static bool mapSharedMemory(EzSharedMemoryRing &ring, int shm_fd, size_t size);
+	static void unmapSharedMemory(EzSharedMemoryRing &ring);
+	static uint32_t *sharedSlotState(EzSharedMemoryRing &ring, unsigned int slot);
+	bool sendSharedMat(const cv::Mat &img);
+	void attachSharedMemory(const uchar *payload, size_t payload_size);
+	cv::Mat readSharedMat(const uchar *payload, size_t payload_size);
+	void releaseSharedSlot();
+	void duplexReaderLoop();
+	void duplexWriterLoop();
+	void publisherAcceptLoop();
+	void subscriberSendLoop(Subscriber &subscriber);
 
 public:
 	EzCppSocket(std::string server_address = "127.0.0.1",
@@ -68,6 +786,31 @@ public:
 	void setSleepBetweenPackets(unsigned int microseconds);
 	unsigned int getSleepBetweenPackets();
 	void setPacketSize(unsigned int number_of_bytes);
+	void setRateLimit(size_t bytes_per_second, size_t burst_size = 0);
+	size_t getRateLimit();
+	void setBinaryFraming(bool enable);
+	bool getBinaryFraming();
+	void setBinaryLists(bool enable);
+	void setLoopStopMessage(bool enable);
+	void setMaxMessageSize(size_t number_of_bytes);
+	void setDatagramSize(unsigned int number_of_bytes);
+	void setDatagramTimeout(unsigned int milliseconds);
+	unsigned long getDroppedFrames();
+	void setSharedMemory(unsigned int slot_count, size_t slot_size);
+	void setImageCodec(ImageCodec codec, int quality = -1, bool keep_channels = false);
+	ImageCodec getImageCodec();
+	void setImageTiles(unsigned int tile_count, unsigned int thread_count = 0);
+	unsigned int getImageTiles();
+	void setStreamingImages(bool enable, TileCallback tile_callback = nullptr);
+	bool getStreamingImages();
+	void setDeltaImages(bool enable, unsigned int tile_size = 64, double threshold = 2.0, unsigned int keyframe_interval = 30);
+	bool getDeltaImages();
+	void setCompression(Compression method, int level = 0, size_t threshold = 1024);
+	Compression getCompression();
+	void setWorkerThreads(unsigned int thread_count);
+	unsigned int getWorkerThreads();
+	bool getBinaryLists();
+	bool getLoopStopMessage();
 
 	bool getLoopFlag();
 	void loop_func_decorator(void (*func_ptr)(EzCppSocket&), bool show_ips);
@@ -85,16 +828,121 @@ public:
 	std::vector<int> readIntList();
 	std::vector<float> readFloatList();
 	cv::Mat readImage();
+	std::vector<cv::Mat> readImages();
+	cv::Mat readMat();
+	template <typename T>
+	EzTensor<T> readTensor();
 
 	// Outgoing
 
 	void sendBool(bool data);
-	void sendString(std::string msg);
+	void sendString(const std::string &msg);
 	void sendInt(int data);
 	void sendFloat(float data);
-	void sendIntList(std::vector<int> data);
-	void sendFloatList(std::vector<float> data);
-	void sendImage(cv::Mat img);
+	void sendIntList(const std::vector<int> &data);
+	void sendFloatList(const std::vector<float> &data);
+	void sendImage(const cv::Mat &img);
+	void sendImages(const std::vector<cv::Mat> &imgs);
+
+	void startDuplex(size_t queue_depth = 4, OverflowPolicy policy = OVERFLOW_DROP_NEWEST);
+	void stopDuplex();
+	bool postImage(const cv::Mat &img);
+	bool pollImage(cv::Mat &img);
+	unsigned int getImagesInFlight();
+
+	void startPublisher(size_t queue_depth = 1, OverflowPolicy policy = OVERFLOW_DROP_OLDEST);
+	void stopPublisher();
+	void publishImage(const cv::Mat &img);
+	unsigned int getSubscriberCount();
+	unsigned long getQueueDroppedFrames();
+
+	void sendMat(const cv::Mat &img);
+	template <typename T>
+	void sendTensor(const T *data, const std::vector<size_t> &shape);
 };
 
+#ifdef EZCPPSOCKET_COROUTINES
+/**
+ * @brief Awaitable image and string calls on a connected EzCppSocket (C++20).
+ * The returned EzTask coroutines are driven by an EzEventLoop, so one thread
+ * can serve many connections. The EzAsyncSocket must outlive its pending calls.
+ */
+class EzAsyncSocket
+{
+public:
+	EzAsyncSocket(EzCppSocket &socket, EzEventLoop &loop);
+	EzAsyncSocket(std::unique_ptr<EzCppSocket> socket, EzEventLoop &loop);
+
+	EzCppSocket &getSocket() { return *this->connection; }
+	EzTask<std::unique_ptr<EzAsyncSocket>> accept();
+	EzTask<std::string> readString();
+	EzTask<void> sendString(std::string msg);
+	EzTask<cv::Mat> readImage();
+	EzTask<void> sendImage(cv::Mat img);
+
+private:
+	std::unique_ptr<EzCppSocket> owned_connection; // Set for connections returned by accept
+	EzCppSocket *connection;
+	EzEventLoop *loop;
+
+	EzTask<void> readFully(void *buffer, size_t size);
+	EzTask<void> writeVectorFully(std::vector<struct iovec> message);
+	EzTask<const uchar *> readPayload(EzCppSocket::MessageType expected_type, size_t &payload_size);
+	EzTask<void> sendFrame(EzCppSocket::MessageType type, std::vector<struct iovec> payload, uint8_t flags = 0, uint8_t codec = 0);
+};
+#endif
+
+template <>
+inline EzCppSocket::DataType EzCppSocket::dataTypeOf<uint8_t>() { return DTYPE_UINT8; }
+template <>
+inline EzCppSocket::DataType EzCppSocket::dataTypeOf<int8_t>() { return DTYPE_INT8; }
+template <>
+inline EzCppSocket::DataType EzCppSocket::dataTypeOf<uint16_t>() { return DTYPE_UINT16; }
+template <>
+inline EzCppSocket::DataType EzCppSocket::dataTypeOf<int16_t>() { return DTYPE_INT16; }
+template <>
+inline EzCppSocket::DataType EzCppSocket::dataTypeOf<int32_t>() { return DTYPE_INT32; }
+template <>
+inline EzCppSocket::DataType EzCppSocket::dataTypeOf<int64_t>() { return DTYPE_INT64; }
+template <>
+inline EzCppSocket::DataType EzCppSocket::dataTypeOf<float>() { return DTYPE_FLOAT32; }
+template <>
+inline EzCppSocket::DataType EzCppSocket::dataTypeOf<double>() { return DTYPE_FLOAT64; }
+
+/**
+ * @brief Read an N-dimensional tensor sent with sendTensor (or send_tensor in Python).
+ * The elements are read straight into the returned tensor.
+ * 
+ * @tparam T Element type, must match the type that was sent
+ * @return EzTensor<T> Received shape and elements
+ */
+template <typename T>
+EzTensor<T> EzCppSocket::readTensor()
+{
+	EzTensor<T> tensor;
+	tensor.shape = this->readTensorHeader(dataTypeOf<T>());
+
+	size_t count = 1;
+	for (auto dim : tensor.shape)
+		count *= dim;
+	tensor.data.resize(count);
+
+	this->readFully(tensor.data.data(), count * sizeof(T));
+	this->readToken(this->tokens.second, false);
+	return tensor;
+}
+
+/**
+ * @brief Send an N-dimensional tensor along with its data type and shape
+ * 
+ * @tparam T Element type (uint8_t, int8_t, uint16_t, int16_t, int32_t, int64_t, float, double)
+ * @param data Pointer to the elements in row-major order
+ * @param shape Size of each dimension (at most 255 dimensions, each smaller than 2^32)
+ */
+template <typename T>
+void EzCppSocket::sendTensor(const T *data, const std::vector<size_t> &shape)
+{
+	this->sendTensorData(dataTypeOf<T>(), data, shape);
+}
+
 #endif
\ No newline at end of file
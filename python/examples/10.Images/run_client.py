@@ -0,0 +1,67 @@
+import sys
+import cv2
+import numpy as np
+from ezpysocket import ezpysocket as ps
+
+# Must match run_server.py
+TILES = 4
+DELTA_FRAMES = 5
+
+errors = 0
+
+
+def check(ok: bool, what: str):
+    """[summary] Print and count the result of one comparison
+
+    Args:
+        ok (bool): [True if the received data matches]
+        what (str): [Name of the data]
+    """
+    global errors
+    print(what, ":", "ok" if ok else "MISMATCH")
+    if not ok:
+        errors += 1
+
+
+def close_image(a, b) -> bool:
+    """[summary] JPEG is lossy, so a JPEG image only has to be close to what was sent
+    """
+    return a is not None and a.shape == b.shape and \
+        np.mean(np.abs(a.astype(np.int16) - b)) < 8
+
+
+def delta_frame(img, i: int):
+    """[summary] Frame i of the delta images: the image with a square moved along
+        its diagonal
+    """
+    frame = img.copy()
+    frame[64 * i:64 * i + 128, 64 * i:64 * i + 128] = 40 * i
+    return frame
+
+
+if __name__ == "__main__":
+    # Init
+    c = ps.EzPySocket(server_mode=False, reconnect_on_address_busy=5.0)
+    c.set_binary_framing(True)
+    img = cv2.imread("../resources/lena.jpg", 1)
+
+    # Images are split into stripes, encoded and decoded in parallel
+    print("Tiled JPEG images ...")
+    c.set_image_tiles(TILES)
+    c.send_image(img)
+    check(close_image(c.receive_image(), img), "Tiled JPEG")
+
+    print("Tiled PNG images ...")
+    c.set_image_codec(c.CODEC_PNG)
+    c.send_image(img)
+    check(np.array_equal(c.receive_image(), img), "Tiled PNG")
+
+    # Delta images are only sent by Cpp, so whole images are sent
+    print("Delta images ...")
+    for i in range(DELTA_FRAMES):
+        c.send_image(delta_frame(img, i))
+
+    c.disconnect()
+
+    print("Client :", "passed" if errors == 0 else "FAILED")
+    sys.exit(0 if errors == 0 else 1)
@@ -0,0 +1,72 @@
+import sys
+import cv2
+import numpy as np
+from ezpysocket import ezpysocket as ps
+
+# Must match run_client.py
+TILES = 4
+DELTA_FRAMES = 5
+
+errors = 0
+
+
+def check(ok: bool, what: str):
+    """[summary] Print and count the result of one comparison
+
+    Args:
+        ok (bool): [True if the received data matches]
+        what (str): [Name of the data]
+    """
+    global errors
+    print(what, ":", "ok" if ok else "MISMATCH")
+    if not ok:
+        errors += 1
+
+
+def close_image(a, b) -> bool:
+    """[summary] JPEG is lossy, so a JPEG image only has to be close to what was sent
+    """
+    return a is not None and a.shape == b.shape and \
+        np.mean(np.abs(a.astype(np.int16) - b)) < 8
+
+
+def delta_frame(img, i: int):
+    """[summary] Frame i of the delta images: the image with a square moved along
+        its diagonal
+    """
+    frame = img.copy()
+    frame[64 * i:64 * i + 128, 64 * i:64 * i + 128] = 40 * i
+    return frame
+
+
+if __name__ == "__main__":
+    # Init
+    s = ps.EzPySocket(reconnect_on_address_busy=5.0)
+    s.set_binary_framing(True)
+    img = cv2.imread("../resources/lena.jpg", 1)
+
+    print("Tiled JPEG images ...")
+    s.set_image_tiles(TILES)
+    recv_img = s.receive_image()
+    check(close_image(recv_img, img), "Tiled JPEG")
+    s.send_image(recv_img)
+
+    print("Tiled PNG images ...")
+    s.set_image_codec(s.CODEC_PNG)
+    check(np.array_equal(s.receive_image(), img), "Tiled PNG")
+    s.send_image(img)
+
+    # Delta images from a Cpp sender are rejected after the first keyframe,
+    # Python senders send whole images
+    print("Delta images ...")
+    for i in range(DELTA_FRAMES):
+        try:
+            check(np.array_equal(s.receive_image(), delta_frame(img, i)), "Delta image " + str(i))
+        except Exception as e:
+            print(e)
+            check(i > 0, "Delta image " + str(i) + " rejected")
+
+    s.disconnect()
+
+    print("Server :", "passed" if errors == 0 else "FAILED")
+    sys.exit(0 if errors == 0 else 1)
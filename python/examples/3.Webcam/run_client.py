@@ -42,10 +42,9 @@ if MODE == 0:
         c = ps.EzPySocket(tokens=["start", "end"],
                           reconnect_on_address_busy=5.0,
                           server_mode=False)
-        # Set configuration as needed (Increase this value incase end token is
-        # not being read, i.e. give time for packets to be written properly from
-        # server end
-        # c.set_sleep_between_packets(0.00005)
+        # Set configuration as needed (Optional delay between packets, reads
+        # and writes always transfer complete messages so no delay is required)
+        # c.set_sleep_between_packets(0.0)
 
     data = {"camera": cam}
     if WITH_SERVER:
@@ -0,0 +1,57 @@
+import sys
+from ezpysocket import ezpysocket as ps
+
+# Must match ITERATIONS of run_server.py
+ITERATIONS = 10
+
+
+def server_sends_first(c: ps.EzPySocket, data: dict):
+    """[summary] Default loop (status string sent after every iteration), the
+        server sends first
+
+    Args:
+        c (ps.EzPySocket): [Socket object]
+        data (dict): [Iteration and error counters]
+    """
+    value = c.receive_int()
+    if value != data["iteration"]:
+        data["errors"] += 1
+    c.send_int(2 * value)
+    data["iteration"] += 1
+    if data["iteration"] == ITERATIONS:
+        c.stop_loop()
+
+
+def client_sends_first(c: ps.EzPySocket, data: dict):
+    """[summary] set_loop_stop_message(True), the client has to send first in
+        every iteration
+
+    Args:
+        c (ps.EzPySocket): [Socket object]
+        data (dict): [Iteration and error counters]
+    """
+    c.send_int(data["iteration"])
+    if c.receive_int() != data["iteration"] + 1:
+        data["errors"] += 1
+    data["iteration"] += 1
+    if data["iteration"] == ITERATIONS:
+        c.stop_loop()
+
+
+if __name__ == "__main__":
+    # Init
+    c = ps.EzPySocket(server_mode=False, reconnect_on_address_busy=5.0)
+    data = {"iteration": 0, "errors": 0}
+
+    print("Server sends first ...")
+    c.client_loop(server_sends_first, data, show_ips=False)
+
+    print("Client sends first, loop ends with a stop message ...")
+    c.set_loop_stop_message(True)
+    data["iteration"] = 0
+    c.client_loop(client_sends_first, data, show_ips=False)
+
+    c.disconnect()
+
+    print("Client :", "passed" if data["errors"] == 0 else "FAILED")
+    sys.exit(0 if data["errors"] == 0 else 1)
@@ -0,0 +1,54 @@
+import sys
+from ezpysocket import ezpysocket as ps
+
+# Must match ITERATIONS of run_client.py
+ITERATIONS = 10
+
+
+def server_sends_first(s: ps.EzPySocket, data: dict):
+    """[summary] Default loop (status string read after every iteration), the
+        server sends first
+
+    Args:
+        s (ps.EzPySocket): [Socket object]
+        data (dict): [Iteration and error counters]
+    """
+    s.send_int(data["iteration"])
+    if s.receive_int() != 2 * data["iteration"]:
+        data["errors"] += 1
+    data["iteration"] += 1
+
+
+def client_sends_first(s: ps.EzPySocket, data: dict):
+    """[summary] set_loop_stop_message(True), the client has to send first in
+        every iteration
+
+    Args:
+        s (ps.EzPySocket): [Socket object]
+        data (dict): [Iteration and error counters]
+    """
+    s.send_int(s.receive_int() + 1)
+    data["iteration"] += 1
+
+
+if __name__ == "__main__":
+    # Init
+    s = ps.EzPySocket(reconnect_on_address_busy=5.0)
+    data = {"iteration": 0, "errors": 0}
+
+    print("Server sends first ...")
+    s.server_loop(server_sends_first, data)
+    if data["iteration"] != ITERATIONS:
+        data["errors"] += 1
+
+    print("Client sends first, loop ends with a stop message ...")
+    s.set_loop_stop_message(True)
+    data["iteration"] = 0
+    s.server_loop(client_sends_first, data)
+    if data["iteration"] != ITERATIONS:
+        data["errors"] += 1
+
+    s.disconnect()
+
+    print("Server :", "passed" if data["errors"] == 0 else "FAILED")
+    sys.exit(0 if data["errors"] == 0 else 1)
@@ -0,0 +1,68 @@
+import sys
+import numpy as np
+from ezpysocket import ezpysocket as ps
+
+# Sent both ways with binary framing and binary lists, must match run_server.py
+STRING = "Binary framing round trip"
+INT = -123456
+FLOAT = 3.25
+INT_LIST = [3 * i - 7 for i in range(100)]
+FLOAT_LIST = [0.25 * i for i in range(40)]
+FLOAT_TENSOR = (0.5 * np.arange(24, dtype=np.float32)).reshape(2, 3, 4)
+INT16_TENSOR = (1000 - 150 * np.arange(15, dtype=np.int16)).reshape(3, 5)
+MAT = np.arange(60, dtype=np.uint8).reshape(4, 5, 3)
+
+errors = 0
+
+
+def check(ok: bool, what: str):
+    """[summary] Print and count the result of one comparison
+
+    Args:
+        ok (bool): [True if the received data matches]
+        what (str): [Name of the data]
+    """
+    global errors
+    print(what, ":", "ok" if ok else "MISMATCH")
+    if not ok:
+        errors += 1
+
+
+def same_array(a, b) -> bool:
+    """[summary] Compare data type, shape and elements of two arrays
+    """
+    return a.dtype == b.dtype and a.shape == b.shape and np.array_equal(a, b)
+
+
+if __name__ == "__main__":
+    # Init
+    c = ps.EzPySocket(server_mode=False, reconnect_on_address_busy=5.0)
+    c.set_binary_framing(True)
+    c.set_binary_lists(True)
+
+# Send examples
+    print("Sending data...")
+    c.send_string(STRING)
+    c.send_int(INT)
+    c.send_float(FLOAT)
+    c.send_int_list(INT_LIST)
+    c.send_float_list(FLOAT_LIST)
+    c.send_tensor(FLOAT_TENSOR)
+    c.send_tensor(INT16_TENSOR)
+    c.send_mat(MAT)
+
+# Receive examples
+    print("Receiving data...")
+    check(c.receive_string() == STRING, "String")
+    check(c.receive_int() == INT, "Int")
+    check(c.receive_float() == FLOAT, "Float")
+    check(list(c.receive_int_list()) == INT_LIST, "Int List")
+    check(list(c.receive_float_list()) == FLOAT_LIST, "Float List")
+    check(same_array(c.receive_tensor(), FLOAT_TENSOR), "Float Tensor")
+    check(same_array(c.receive_tensor(), INT16_TENSOR), "Int16 Tensor")
+    check(same_array(c.receive_mat(), MAT), "Mat")
+
+    c.disconnect()
+
+    print("Client :", "passed" if errors == 0 else "FAILED")
+    sys.exit(0 if errors == 0 else 1)
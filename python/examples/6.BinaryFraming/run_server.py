@@ -0,0 +1,68 @@
+import sys
+import numpy as np
+from ezpysocket import ezpysocket as ps
+
+# Sent both ways with binary framing and binary lists, must match run_client.py
+STRING = "Binary framing round trip"
+INT = -123456
+FLOAT = 3.25
+INT_LIST = [3 * i - 7 for i in range(100)]
+FLOAT_LIST = [0.25 * i for i in range(40)]
+FLOAT_TENSOR = (0.5 * np.arange(24, dtype=np.float32)).reshape(2, 3, 4)
+INT16_TENSOR = (1000 - 150 * np.arange(15, dtype=np.int16)).reshape(3, 5)
+MAT = np.arange(60, dtype=np.uint8).reshape(4, 5, 3)
+
+errors = 0
+
+
+def check(ok: bool, what: str):
+    """[summary] Print and count the result of one comparison
+
+    Args:
+        ok (bool): [True if the received data matches]
+        what (str): [Name of the data]
+    """
+    global errors
+    print(what, ":", "ok" if ok else "MISMATCH")
+    if not ok:
+        errors += 1
+
+
+def same_array(a, b) -> bool:
+    """[summary] Compare data type, shape and elements of two arrays
+    """
+    return a.dtype == b.dtype and a.shape == b.shape and np.array_equal(a, b)
+
+
+if __name__ == "__main__":
+    # Init
+    s = ps.EzPySocket(reconnect_on_address_busy=5.0)
+    s.set_binary_framing(True)
+    s.set_binary_lists(True)
+
+# Receive examples
+    print("Receiving data...")
+    check(s.receive_string() == STRING, "String")
+    check(s.receive_int() == INT, "Int")
+    check(s.receive_float() == FLOAT, "Float")
+    check(list(s.receive_int_list()) == INT_LIST, "Int List")
+    check(list(s.receive_float_list()) == FLOAT_LIST, "Float List")
+    check(same_array(s.receive_tensor(), FLOAT_TENSOR), "Float Tensor")
+    check(same_array(s.receive_tensor(), INT16_TENSOR), "Int16 Tensor")
+    check(same_array(s.receive_mat(), MAT), "Mat")
+
+# Send examples
+    print("Sending data...")
+    s.send_string(STRING)
+    s.send_int(INT)
+    s.send_float(FLOAT)
+    s.send_int_list(INT_LIST)
+    s.send_float_list(FLOAT_LIST)
+    s.send_tensor(FLOAT_TENSOR)
+    s.send_tensor(INT16_TENSOR)
+    s.send_mat(MAT)
+
+    s.disconnect()
+
+    print("Server :", "passed" if errors == 0 else "FAILED")
+    sys.exit(0 if errors == 0 else 1)
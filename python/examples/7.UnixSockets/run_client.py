@@ -0,0 +1,61 @@
+import socket
+import sys
+import numpy as np
+from ezpysocket import ezpysocket as ps
+
+# Echoed back over a stream socket and a seqpacket socket, must match run_server.py
+STREAM_PATH = "/tmp/ezsocket_example.sock"
+SEQPACKET_PATH = "@ezsocket_example"  # Abstract namespace, no file is created
+STRING = "Unix domain socket round trip"
+INT_LIST = [i * i for i in range(1000)]
+# Larger than a seqpacket record, so it is carried in several records
+MAT = (np.arange(480 * 640 * 3) % 251).astype(np.uint8).reshape(480, 640, 3)
+
+errors = 0
+
+
+def check(ok: bool, what: str):
+    """[summary] Print and count the result of one comparison
+
+    Args:
+        ok (bool): [True if the received data matches]
+        what (str): [Name of the data]
+    """
+    global errors
+    print(what, ":", "ok" if ok else "MISMATCH")
+    if not ok:
+        errors += 1
+
+
+def request(socket_type, path: str):
+    """[summary] Send the data to the server and check what it echoes back
+
+    Args:
+        socket_type ([type]): [socket.SOCK_STREAM or socket.SOCK_SEQPACKET]
+        path (str): [Socket path]
+    """
+    c = ps.EzPySocket(server_address=path, socket_family=socket.AF_UNIX,
+                      socket_type=socket_type, server_mode=False,
+                      reconnect_on_address_busy=1.0)
+
+    print("Sending data...")
+    c.send_string(STRING)
+    c.send_int_list(INT_LIST)
+    c.send_mat(MAT)
+
+    print("Receiving data...")
+    check(c.receive_string() == STRING, "String")
+    check(list(c.receive_int_list()) == INT_LIST, "Int List")
+    check(np.array_equal(c.receive_mat(), MAT), "Mat")
+
+    c.disconnect()
+
+
+if __name__ == "__main__":
+    print("SOCK_STREAM at", STREAM_PATH, "...")
+    request(socket.SOCK_STREAM, STREAM_PATH)
+    print("SOCK_SEQPACKET at", SEQPACKET_PATH, "...")
+    request(socket.SOCK_SEQPACKET, SEQPACKET_PATH)
+
+    print("Client :", "passed" if errors == 0 else "FAILED")
+    sys.exit(0 if errors == 0 else 1)
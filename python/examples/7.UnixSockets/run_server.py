@@ -0,0 +1,60 @@
+import socket
+import sys
+import numpy as np
+from ezpysocket import ezpysocket as ps
+
+# Echoed back over a stream socket and a seqpacket socket, must match run_client.py
+STREAM_PATH = "/tmp/ezsocket_example.sock"
+SEQPACKET_PATH = "@ezsocket_example"  # Abstract namespace, no file is created
+STRING = "Unix domain socket round trip"
+INT_LIST = [i * i for i in range(1000)]
+# Larger than a seqpacket record, so it is carried in several records
+MAT = (np.arange(480 * 640 * 3) % 251).astype(np.uint8).reshape(480, 640, 3)
+
+errors = 0
+
+
+def check(ok: bool, what: str):
+    """[summary] Print and count the result of one comparison
+
+    Args:
+        ok (bool): [True if the received data matches]
+        what (str): [Name of the data]
+    """
+    global errors
+    print(what, ":", "ok" if ok else "MISMATCH")
+    if not ok:
+        errors += 1
+
+
+def serve(socket_type, path: str):
+    """[summary] Receive the data from the client and echo it back
+
+    Args:
+        socket_type ([type]): [socket.SOCK_STREAM or socket.SOCK_SEQPACKET]
+        path (str): [Socket path]
+    """
+    s = ps.EzPySocket(server_address=path, socket_family=socket.AF_UNIX,
+                      socket_type=socket_type, reconnect_on_address_busy=5.0)
+
+    print("Receiving data...")
+    check(s.receive_string() == STRING, "String")
+    check(list(s.receive_int_list()) == INT_LIST, "Int List")
+    check(np.array_equal(s.receive_mat(), MAT), "Mat")
+
+    print("Sending data...")
+    s.send_string(STRING)
+    s.send_int_list(INT_LIST)
+    s.send_mat(MAT)
+
+    s.disconnect()
+
+
+if __name__ == "__main__":
+    print("SOCK_STREAM at", STREAM_PATH, "...")
+    serve(socket.SOCK_STREAM, STREAM_PATH)
+    print("SOCK_SEQPACKET at", SEQPACKET_PATH, "...")
+    serve(socket.SOCK_SEQPACKET, SEQPACKET_PATH)
+
+    print("Server :", "passed" if errors == 0 else "FAILED")
+    sys.exit(0 if errors == 0 else 1)
@@ -0,0 +1,53 @@
+import socket
+import sys
+import cv2
+import numpy as np
+from ezpysocket import ezpysocket as ps
+
+# Echoed back over UDP, must match run_server.py
+STRING = "UDP round trip"
+# Split into about 40 datagrams of the default 1400 bytes
+MAT = (np.arange(120 * 160 * 3) % 251).astype(np.uint8).reshape(120, 160, 3)
+
+errors = 0
+
+
+def check(ok: bool, what: str):
+    """[summary] Print and count the result of one comparison
+
+    Args:
+        ok (bool): [True if the received data matches]
+        what (str): [Name of the data]
+    """
+    global errors
+    print(what, ":", "ok" if ok else "MISMATCH")
+    if not ok:
+        errors += 1
+
+
+if __name__ == "__main__":
+    # UDP has no connection to wait for, the server has to be up before the client sends
+    c = ps.EzPySocket(socket_type=socket.SOCK_DGRAM, server_mode=False,
+                      reconnect_on_address_busy=1.0)
+    # A lost datagram fails the test instead of blocking it
+    c.set_datagram_timeout(5.0)
+    img = cv2.imread("../resources/lena.jpg", 1)
+
+# Send examples
+    print("Sending data...")
+    c.send_string(STRING)
+    c.send_mat(MAT)
+    c.send_image(img)
+
+# Receive examples
+    print("Receiving data...")
+    check(c.receive_string() == STRING, "String")
+    check(np.array_equal(c.receive_mat(), MAT), "Mat")
+    recv_img = c.receive_image()
+    check(recv_img is not None and recv_img.shape == img.shape, "Image")
+
+    print("Dropped frames :", c.get_dropped_frames())
+    c.disconnect()
+
+    print("Client :", "passed" if errors == 0 else "FAILED")
+    sys.exit(0 if errors == 0 else 1)
@@ -0,0 +1,50 @@
+import socket
+import sys
+import cv2
+import numpy as np
+from ezpysocket import ezpysocket as ps
+
+# Echoed back over UDP, must match run_client.py
+STRING = "UDP round trip"
+# Split into about 40 datagrams of the default 1400 bytes
+MAT = (np.arange(120 * 160 * 3) % 251).astype(np.uint8).reshape(120, 160, 3)
+
+errors = 0
+
+
+def check(ok: bool, what: str):
+    """[summary] Print and count the result of one comparison
+
+    Args:
+        ok (bool): [True if the received data matches]
+        what (str): [Name of the data]
+    """
+    global errors
+    print(what, ":", "ok" if ok else "MISMATCH")
+    if not ok:
+        errors += 1
+
+
+if __name__ == "__main__":
+    # Returns once the first datagram of the client has arrived
+    s = ps.EzPySocket(socket_type=socket.SOCK_DGRAM, reconnect_on_address_busy=5.0)
+    img = cv2.imread("../resources/lena.jpg", 1)
+
+# Receive examples
+    print("Receiving data...")
+    check(s.receive_string() == STRING, "String")
+    check(np.array_equal(s.receive_mat(), MAT), "Mat")
+    recv_img = s.receive_image()
+    check(recv_img is not None and recv_img.shape == img.shape, "Image")
+
+# Send examples
+    print("Sending data...")
+    s.send_string(STRING)
+    s.send_mat(MAT)
+    s.send_image(recv_img)
+
+    print("Dropped frames :", s.get_dropped_frames())
+    s.disconnect()
+
+    print("Server :", "passed" if errors == 0 else "FAILED")
+    sys.exit(0 if errors == 0 else 1)
@@ -0,0 +1,54 @@
+import sys
+import numpy as np
+from ezpysocket import ezpysocket as ps
+
+# Echoed back with LZ4 and then zstd compression, must match run_server.py
+# Needs the lz4 and zstandard packages (pip install lz4 zstandard)
+LONG_STRING = "".join("Compressible line " + str(i % 10) + "\n" for i in range(2000))
+SHORT_STRING = "Below the compression threshold"
+FLOAT_LIST = [0.5 * (i % 16) for i in range(10000)]
+MAT = np.repeat(np.arange(240, dtype=np.uint8), 320 * 3).reshape(240, 320, 3)
+
+errors = 0
+
+
+def check(ok: bool, what: str):
+    """[summary] Print and count the result of one comparison
+
+    Args:
+        ok (bool): [True if the received data matches]
+        what (str): [Name of the data]
+    """
+    global errors
+    print(what, ":", "ok" if ok else "MISMATCH")
+    if not ok:
+        errors += 1
+
+
+if __name__ == "__main__":
+    # Init
+    c = ps.EzPySocket(server_mode=False, reconnect_on_address_busy=5.0)
+    c.set_binary_framing(True)
+    c.set_binary_lists(True)
+
+    for method in [c.COMPRESSION_LZ4, c.COMPRESSION_ZSTD]:
+        print("LZ4" if method == c.COMPRESSION_LZ4 else "zstd", "...")
+        c.set_compression(method)
+        check(c.get_compression() == method, "Compression available")
+
+        print("Sending data...")
+        c.send_string(LONG_STRING)
+        c.send_string(SHORT_STRING)
+        c.send_float_list(FLOAT_LIST)
+        c.send_mat(MAT)
+
+        print("Receiving data...")
+        check(c.receive_string() == LONG_STRING, "Long String")
+        check(c.receive_string() == SHORT_STRING, "Short String")
+        check(list(c.receive_float_list()) == FLOAT_LIST, "Float List")
+        check(np.array_equal(c.receive_mat(), MAT), "Mat")
+
+    c.disconnect()
+
+    print("Client :", "passed" if errors == 0 else "FAILED")
+    sys.exit(0 if errors == 0 else 1)
@@ -1,15 +1,216 @@
+import itertools
+import mmap
+import os
+import select
 import socket
+import stat
+import struct
 import cv2
 import numpy as np
 import time
+from concurrent.futures import ThreadPoolExecutor
+
+# Optional payload compression (see set_compression)
+try:
+    import lz4.block
+except ImportError:
+    lz4 = None
+try:
+    import zstandard
+except ImportError:
+    zstandard = None
+
+
+class EzSharedMemoryRing:
+    """[summary] Mapping of a shared memory ring of frame slots (see set_shared_memory)
+    """
+
+    def __init__(self, name: str, memory: mmap.mmap, slot_count: int, slot_size: int):
+        self.name = name
+        self.memory = memory
+        self.slot_count = slot_count
+        self.slot_size = slot_size
+        # Slots start at the first page boundary after the header and slot states
+        self.data_offset = -(-(EzPySocket.SHM_HEADER_SIZE + slot_count * EzPySocket.SHM_STATE_STRIDE)
+                             // mmap.PAGESIZE) * mmap.PAGESIZE
+        self.next_slot = 0
+
+    def state_offset(self, slot: int) -> int:
+        return EzPySocket.SHM_HEADER_SIZE + slot * EzPySocket.SHM_STATE_STRIDE
+
+    def get_state(self, slot: int) -> int:
+        return struct.unpack_from("<I", self.memory, self.state_offset(slot))[0]
+
+    def set_state(self, slot: int, state: int):
+        struct.pack_into("<I", self.memory, self.state_offset(slot), state)
+
+    def slot_offset(self, slot: int) -> int:
+        return self.data_offset + slot * self.slot_size
+
+    def close(self):
+        try:
+            self.memory.close()
+        except BufferError:
+            pass  # Arrays returned by receive_mat still use the mapping
 
 
 class EzPySocket:
     """[summary] Python - Cpp Communication Server Object
     """
 
-    __sleep_between_packets = 0.00005
+    # Type tags carried in the binary frame header
+    MSG_STRING = 1
+    MSG_INT = 2
+    MSG_FLOAT = 3
+    MSG_INT_LIST = 4
+    MSG_FLOAT_LIST = 5
+    MSG_IMAGE = 6
+    MSG_MAT = 7
+    MSG_TENSOR = 8
+    MSG_CONTROL = 9
+    MSG_SHM_MAT = 10
+    MSG_SHM_ATTACH = 11
+    MSG_IMAGE_BATCH = 12
+
+    # Codes carried by MSG_CONTROL messages (1 byte payload)
+    CONTROL_LOOP_STOP = 1
+    # Sent in place of the 16 digit size header to stop the server loop (text framing)
+    __loop_stop_marker = b"EZSOCKETLOOPSTOP"
+
+    # Codecs send_image can encode with (see set_image_codec)
+    CODEC_JPEG = 0
+    CODEC_PNG = 1
+    CODEC_WEBP = 2
+    CODEC_RAW = 3  # Mat header and pixel data as sent by send_mat, no encoding
+    __codec_extensions = {CODEC_JPEG: '.jpg',
+                          CODEC_PNG: '.png', CODEC_WEBP: '.webp'}
+    __codec_quality_params = {CODEC_JPEG: cv2.IMWRITE_JPEG_QUALITY,
+                              CODEC_PNG: cv2.IMWRITE_PNG_COMPRESSION,
+                              CODEC_WEBP: cv2.IMWRITE_WEBP_QUALITY}
+
+    # Bits of the frame header flags
+    FLAG_KEEP_CHANNELS = 1  # Decode the image with its own channels and depth (IMREAD_UNCHANGED)
+    FLAG_LZ4 = 2  # Message is LZ4 compressed
+    FLAG_ZSTD = 4  # Message is zstd compressed
+    FLAG_TILED = 8  # Image is split into stripes encoded on their own (see set_image_tiles)
+    FLAG_DELTA = 16  # Image carries only the tiles that changed (Cpp setDeltaImages, not decoded here)
+    FLAG_KEYFRAME = 32  # Whole image that following delta images are patched into
+
+    # Payload compression methods (see set_compression)
+    COMPRESSION_NONE = 0
+    COMPRESSION_LZ4 = 1
+    COMPRESSION_ZSTD = 2
+    # Compressed message layout (FLAG_LZ4/FLAG_ZSTD), replacing tokens and payload:
+    # [uint32 size of the tokens and payload][compressed tokens and payload]
+    __compression_header = struct.Struct("<I")
+
+    # Tiled image payload layout (FLAG_TILED, little-endian), followed by the encoded stripes in order:
+    # [uint32 rows][uint32 cols][uint32 tile count][per tile: uint32 rows of the stripe, uint32 encoded size]
+    __tiled_header = struct.Struct("<III")
+    __tile_entry = struct.Struct("<II")
+
+    # Image batch payload layout (MSG_IMAGE_BATCH, little-endian), followed by the images in order,
+    # each encoded like a send_image payload with the codec of the frame header:
+    # [uint32 image count][per image: uint32 encoded size]
+    __batch_header = struct.Struct("<I")
+
+    # Element types carried in binary list headers
+    DTYPE_UINT8 = 1
+    DTYPE_INT8 = 2
+    DTYPE_UINT16 = 3
+    DTYPE_INT16 = 4
+    DTYPE_INT32 = 5
+    DTYPE_INT64 = 6
+    DTYPE_FLOAT32 = 7
+    DTYPE_FLOAT64 = 8
+    __dtypes = {DTYPE_UINT8: np.dtype('<u1'), DTYPE_INT8: np.dtype('<i1'),
+                DTYPE_UINT16: np.dtype('<u2'), DTYPE_INT16: np.dtype('<i2'),
+                DTYPE_INT32: np.dtype('<i4'), DTYPE_INT64: np.dtype('<i8'),
+                DTYPE_FLOAT32: np.dtype('<f4'), DTYPE_FLOAT64: np.dtype('<f8')}
+
+    # Binary frame header layout (little-endian):
+    # [uint32 payload size][uint8 message type][uint8 flags][uint8 image codec][uint8 reserved]
+    __frame_header = struct.Struct("<IBBBx")
+
+    # Raw Mat header layout (little-endian), followed by rows * step bytes of pixel data:
+    # [uint32 rows][uint32 cols][uint32 OpenCV type][uint32 step (bytes per row)]
+    __mat_header = struct.Struct("<IIII")
+
+    # Binary list header layout (little-endian), followed by count raw elements:
+    # [uint8 data type][uint8 x3 reserved][uint32 element count]
+    __list_header = struct.Struct("<B3xI")
+
+    # Tensor header layout (little-endian), followed by the elements in row-major order:
+    # [uint8 data type][uint8 number of dimensions][uint16 reserved][uint32 size of each dimension ...]
+    __tensor_header = struct.Struct("<BBH")
+    # Shared memory ring layout: [ring header][slot states][slots]
+    # Ring header: [uint32 magic][uint32 slot count][uint64 slot size], padded to SHM_HEADER_SIZE
+    # Slot states: one uint32 (SHM_SLOT_FREE/SHM_SLOT_READY) per slot, each on its own cache line
+    # Slots: slot count * slot size bytes, starting at a page boundary
+    SHM_HEADER_SIZE = 64
+    SHM_STATE_STRIDE = 64
+    SHM_MAGIC = 0x4D535A45  # "EZSM"
+    SHM_SLOT_FREE = 0
+    SHM_SLOT_READY = 1
+    __shm_ring_header = struct.Struct("<IIQ")
+    # MSG_SHM_ATTACH payload (little-endian): [uint32 slot count][uint32 reserved][uint64 slot size][shm name]
+    __shm_attach_header = struct.Struct("<I4xQ")
+    # MSG_SHM_MAT payload (little-endian): [uint32 slot][Mat header]
+    __shm_mat_header = struct.Struct("<IIIII")
+    __shm_ring_counter = itertools.count()
+
+    # With SOCK_DGRAM, every message is sent as one frame split into datagrams of at most
+    # datagram size bytes, each starting with this header (little-endian):
+    # [uint32 frame id][uint32 frame size][uint32 fragment offset][uint16 fragment index][uint16 fragment count]
+    __datagram_header = struct.Struct("<IIIHH")
+    # Largest UDP payload (IPv4)
+    MAX_DATAGRAM_SIZE = 65507
+    # Frames reassembled at the same time, the oldest is dropped when a newer one needs the slot
+    __datagram_reassembly_slots = 4
+
+    # OpenCV depth codes for the numpy dtypes that OpenCV supports
+    __cv_depths = {np.dtype('uint8'): 0, np.dtype('int8'): 1,
+                   np.dtype('uint16'): 2, np.dtype('int16'): 3,
+                   np.dtype('int32'): 4, np.dtype('float32'): 5,
+                   np.dtype('float64'): 6}
+
+    __sleep_between_packets = 0.0
     __packet_size = 59625
+    __rate_limit = 0
+    __rate_burst = 0
+    __rate_tokens = 0.0
+    __rate_refill_time = 0.0
+    # With SOCK_SEQPACKET (AF_UNIX), the byte stream is carried in records of at most this size
+    __seqpacket_record_size = 65536
+    __staged_record = memoryview(b"")
+    __datagram_size = 1400
+    __datagram_timeout = 0.0
+    __next_datagram_frame = 0
+    __last_datagram_frame = None
+    __dropped_frame_count = 0
+    __bound_path = None
+    __shm_outbound = None
+    __shm_inbound = None
+    __shm_attach_sent = False
+    __shm_held_slot = -1
+    __binary_framing = False
+    __binary_lists = False
+    __loop_stop_message = False
+    __image_codec = CODEC_JPEG
+    __image_quality = -1
+    __keep_channels = False
+    __image_tiles = 1
+    __tile_threads = 0
+    __tile_pool = None
+    __received_flags = 0
+    __received_codec = CODEC_JPEG
+    __compression = COMPRESSION_NONE
+    __compression_level = 0
+    __compression_threshold = 1024
+    __inflated = memoryview(b"")
+    __recv_buffer = bytearray()
+    # Largest message accepted from the peer (1 GiB)
+    __max_message_size = 1 << 30
 
     __loop_flag = False
     __loop_iteration_count = 0
@@ -33,15 +234,18 @@ class EzPySocket:
 
             server_port (int, optional): [Port number]. Defaults to 10000.
 
-            socket_family ([type], optional): [IPV4/IPV6]. Defaults to
+            socket_family ([type], optional): [IPV4/IPV6/Unix domain]. Defaults to
             socket.AF_INET.
             # AF_INET (IPv4 protocol)
             # AF_INET6 (IPv6 protocol)
+            # AF_UNIX (same host, server_address is the socket path and the port
+            # is not used, a leading '@' selects the abstract namespace)
 
             socket_type ([type], optional): [TCP/UDP]. Defaults to
             socket.SOCK_STREAM.
             # SOCK_STREAM: TCP(reliable, connection oriented)
             # SOCK_DGRAM: UDP(unreliable, connectionless)
+            # SOCK_SEQPACKET: Unix domain records (AF_UNIX only)
 
             debug (bool, optional): [For printing debug]. Defaults to False.
 
@@ -60,24 +264,36 @@ class EzPySocket:
         self.__reconnect_on_address_busy = reconnect_on_address_busy
         self.__tokens = tokens
         self.__auto_connect = auto_connect
+        # Frames being reassembled (SOCK_DGRAM): frame id -> [data, received fragments, fragments left]
+        self.__datagram_frames = {}
 
         self.create_socket()
 
         # Bind sever socket to specific address and port
-        self.__server_address = (server_address, server_port)
+        if self.__socket_family == socket.AF_UNIX:
+            self.__server_address = "\0" + server_address[1:] \
+                if server_address.startswith("@") else server_address
+        else:
+            self.__server_address = (server_address, server_port)
 
         if self.__debug:
             print("Starting " + ("server" if server_mode else "client"))
-            print('Starting up on {} port {}'.format(*self.__server_address))
+            print('Starting up on', self.__server_address)
 
         address_free_flag = False
         if server_mode:
             while not address_free_flag:
                 try:
                     # To disable lingering consequences immediately after closing connection
-                    self.__sock.setsockopt(
-                        socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+                    if self.__socket_family == socket.AF_UNIX:
+                        self.__remove_stale_socket_file()
+                    else:
+                        self.__sock.setsockopt(
+                            socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
                     self.__sock.bind(self.__server_address)
+                    if self.__socket_family == socket.AF_UNIX and \
+                            not self.__server_address.startswith("\0"):
+                        self.__bound_path = self.__server_address
                     address_free_flag = True
                 except OSError as oserr:
                     print(oserr)
@@ -106,6 +322,8 @@ class EzPySocket:
                     self.__sock.connect(self.__server_address)
                     address_free_flag = True
                     self.__connection = self.__sock
+                    if self.__socket_type == socket.SOCK_DGRAM:
+                        self.__configure_datagram_socket()
                     print("Socket connection successful")
                 except Exception as e:
                     print("Socket connection failed : ", e)
@@ -120,6 +338,13 @@ class EzPySocket:
                         exit()
 
     def server_listen(self):
+        if self.__socket_type == socket.SOCK_DGRAM:
+            # UDP has no connections, the bound socket talks to the first client heard from
+            self.__configure_datagram_socket()
+            if self.__auto_connect:
+                self.connect()
+            return
+
         # Listen for incoming connection(s) from clients
         self.__sock.listen(self.__connection_count)
 
@@ -153,6 +378,16 @@ class EzPySocket:
         This is a blocking function and hence won't return until a connection
         is established.
         """
+        if self.__socket_type == socket.SOCK_DGRAM:
+            # The first datagram tells us who the client is, it is left for the first read
+            print('Waiting for a client datagram ...')
+            _, self.__client_address = self.__sock.recvfrom(1, socket.MSG_PEEK)
+            self.__sock.connect(self.__client_address)
+            self.__connection = self.__sock
+            print(f'Connection from {self.__client_address} has been '
+                  'established.')
+            return
+
         # Wait for a connection
         print('Waiting for a connection ...')
         # (Blocking) Extract first connection request and connect
@@ -170,11 +405,45 @@ class EzPySocket:
             self.__sock.close()
         except:
             print("Connection already closed successfully")
+        # Remove the socket file of a Unix domain server
+        if self.__bound_path is not None:
+            try:
+                os.unlink(self.__bound_path)
+            except OSError:
+                pass
+            self.__bound_path = None
+
+        self.__release_shared_slot()
+        for ring in (self.__shm_inbound, self.__shm_outbound):
+            if ring is not None:
+                ring.close()
+        self.__unlink_shared_memory(self.__shm_outbound)
+        self.__shm_inbound = self.__shm_outbound = None
+
+    def __remove_stale_socket_file(self):
+        """[summary] Remove the socket file left behind by a Unix domain server that is
+            no longer running, so bind can reuse the path. A file that still accepts
+            connections is left alone and bind reports the address as busy.
+        """
+        path = self.__server_address
+        try:
+            if path.startswith("\0") or not stat.S_ISSOCK(os.stat(path).st_mode):
+                return
+        except OSError:
+            return
+        with socket.socket(socket.AF_UNIX, self.__socket_type) as probe:
+            try:
+                probe.connect(path)
+            except ConnectionRefusedError:
+                print("Removing stale socket file", path)
+                os.unlink(path)
+            except OSError:
+                pass
 
     def set_sleep_between_packets(self, seconds: float):
-        """[summary] A setter function to add a delay between packet read/write
-            which ensures that it does so properly. It's been observed that 
-            increasing this when images don't come through properly helps.
+        """[summary] A setter function to add a delay between packet read/write.
+            Reads and writes always transfer the complete message, so this is
+            no longer needed for correctness and defaults to 0 (no delay).
 
         Args:
             seconds (float): [Time to sleep between packet read/write]
@@ -198,6 +467,451 @@ class EzPySocket:
         else:
             print("\nInvalid packet size was provided. Not updating packet size.\n")
 
+    def set_max_message_size(self, number_of_bytes: int):
+        """[summary] A setter function to set the largest message that will be accepted.
+            Message sizes come from the peer, so this bounds how much memory a single
+            (possibly corrupt) header can make the receive buffer grow to.
+
+        Args:
+            number_of_bytes (int): [Maximum message size in bytes]
+        """
+        self.__max_message_size = number_of_bytes
+
+    def __check_message_size(self, size: int):
+        """[summary] Reject a size announced by the peer if it is larger than the
+            maximum message size, before anything is allocated for it
+
+        Args:
+            size (int): [Number of bytes announced by the peer]
+
+        Raises:
+            Exception: [Message size check in received message failed]
+        """
+        if size > self.__max_message_size:
+            print("Received message size", size, "is larger than the maximum message size",
+                  self.__max_message_size, "! Use set_max_message_size to allow larger messages.")
+            raise Exception("Message size check in received message failed")
+
+    def set_rate_limit(self, bytes_per_second: int, burst_size: int = 0):
+        """[summary] A setter function to cap the rate of outgoing data with a token
+            bucket. Every send is limited to burst_size bytes and is followed by a sleep
+            that keeps the average at bytes_per_second, so the link stays shared
+            predictably whatever the frame size.
+
+        Args:
+            bytes_per_second (int): [Average outgoing rate (0 removes the limit)]
+            burst_size (int, optional): [Bytes that may be sent at once].
+            Defaults to 0 (50 ms worth of data).
+        """
+        self.__rate_limit = bytes_per_second
+        self.__rate_burst = burst_size if burst_size > 0 else max(bytes_per_second // 20, 1)
+        self.__rate_tokens = float(self.__rate_burst)
+        self.__rate_refill_time = time.monotonic()
+
+    def get_rate_limit(self):
+        """[summary] A getter function for the outgoing rate limit in bytes per second (0 if unlimited)
+        """
+        return self.__rate_limit
+
+    def __pace_send(self, sent: int):
+        """[summary] Take bytes that were just sent out of the token bucket (see
+            set_rate_limit). If the bucket runs dry, sleep until it is paid back.
+
+        Args:
+            sent (int): [Number of bytes sent]
+        """
+        if self.__rate_limit == 0:
+            return
+        now = time.monotonic()
+        self.__rate_tokens = min(self.__rate_burst, self.__rate_tokens +
+                                 (now - self.__rate_refill_time) * self.__rate_limit) - sent
+        self.__rate_refill_time = now
+        if self.__rate_tokens < 0:
+            time.sleep(-self.__rate_tokens / self.__rate_limit)
+
+    def set_binary_framing(self, enable: bool):
+        """[summary] A setter function to switch between binary frame headers and the
+            16 digit ASCII size headers. Binary framing sends a fixed width little-endian
+            header (payload size, message type, flags) in place of the size string.
+            Note: Both ends of the connection must use the same setting.
+
+        Args:
+            enable (bool): [True to use binary frame headers]
+        """
+        self.__binary_framing = enable
+
+    def get_binary_framing(self):
+        """[summary] A getter function to check if binary frame headers are in use.
+        """
+        return self.__binary_framing
+
+    def set_binary_lists(self, enable: bool):
+        """[summary] A setter function to switch int/float lists between the text
+            format ("[1, 2, 3]") and a binary format (element count, data type and
+            the raw contiguous elements). Binary lists are received as numpy arrays
+            and keep full float precision.
+            Note: Both ends of the connection must use the same setting.
+
+        Args:
+            enable (bool): [True to send lists in binary format]
+        """
+        self.__binary_lists = enable
+
+    def get_binary_lists(self):
+        """[summary] A getter function to check if lists are sent in binary format.
+        """
+        return self.__binary_lists
+
+    def set_loop_stop_message(self, enable: bool):
+        """[summary] A setter function to choose how a loop with loop_count 0 ends.
+            By default the client sends a status string ("Active"/"Stop") after every
+            iteration and the server reads it after every callback. When enabled, the
+            client sends a single stop message when its loop ends and the server peeks
+            at the next message after each callback, so iterations carry nothing but
+            user data. This needs the client to send first in every iteration; a server
+            callback that sends before reading would wait on the peek forever.
+            It stays disabled by default, since loops whose server sends first and peers
+            built before this option only work with the status string protocol.
+            Note: Both ends of the connection must use the same setting.
+
+        Args:
+            enable (bool): [True to end loops with a single stop message]. Defaults to False.
+        """
+        self.__loop_stop_message = enable
+
+    def get_loop_stop_message(self):
+        """[summary] A getter function to check if loops end with a single stop message.
+        """
+        return self.__loop_stop_message
+
+    def set_datagram_size(self, number_of_bytes: int):
+        """[summary] A setter function for the size of the datagrams a message is split
+            into with SOCK_DGRAM (fragment header included). The default of 1400 bytes
+            fits a 1500 byte Ethernet MTU, so no datagram is fragmented by IP. Raise it
+            on networks with a larger MTU (e.g. loopback). Each end can use its own size.
+
+        Args:
+            number_of_bytes (int): [Datagram size in bytes]
+        """
+        if not self.__datagram_header.size < number_of_bytes <= self.MAX_DATAGRAM_SIZE:
+            print("Datagram size should be between", self.__datagram_header.size + 1,
+                  "and", self.MAX_DATAGRAM_SIZE, "bytes")
+            return
+        self.__datagram_size = number_of_bytes
+
+    def set_datagram_timeout(self, seconds: float):
+        """[summary] A setter function for how long a read waits for the next complete
+            frame with SOCK_DGRAM. receive_image returns None when it times out, other
+            reads raise TimeoutError. Set it on the end that waits for replies (usually
+            the client), so a lost frame skips an exchange instead of blocking both ends.
+
+        Args:
+            seconds (float): [Timeout in seconds (0 waits forever)]
+        """
+        self.__datagram_timeout = seconds
+
+    def get_dropped_frames(self):
+        """[summary] A getter function for the number of frames that were skipped with
+            SOCK_DGRAM because datagrams were lost, arrived late or a newer frame was
+            completed first.
+        """
+        return self.__dropped_frame_count
+
+    def __configure_datagram_socket(self):
+        """[summary] Enlarge the socket buffers of a SOCK_DGRAM socket. A frame arrives
+            as a burst of datagrams, and the kernel drops whatever does not fit in the
+            receive buffer (the sizes are capped by net.core.rmem_max/wmem_max).
+        """
+        self.__sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4 << 20)
+        self.__sock.setsockopt(socket.SOL_SOCKET, socket.SO_SNDBUF, 4 << 20)
+
+    @staticmethod
+    def __frame_is_newer(frame_id: int, other_id: int) -> bool:
+        """[summary] Compare frame ids, allowing for wrap-around of the 32 bit counter
+        """
+        return 0 < (frame_id - other_id) & 0xFFFFFFFF < 0x80000000
+
+    def __send_datagrams(self, buffers: list):
+        """[summary] Send a complete message as one frame of datagrams (SOCK_DGRAM).
+            Each datagram carries the frame id and the offset of its fragment, so the
+            receiver can reassemble the frame in any order and tell when it is complete.
+
+        Args:
+            buffers (list): [bytes-like objects that make up the message, in order]
+        """
+        data = memoryview(b"".join(buffers))
+        fragment_size = self.__datagram_size - self.__datagram_header.size
+        fragment_count = max(-(-len(data) // fragment_size), 1)
+        if len(data) > 0xFFFFFFFF or fragment_count > 0xFFFF:
+            raise ValueError("Message of " + str(len(data)) + " bytes does not fit in 65535 datagrams of " +
+                             str(self.__datagram_size) + " bytes! Use set_datagram_size to send larger datagrams.")
+        frame_id = self.__next_datagram_frame
+        self.__next_datagram_frame = (frame_id + 1) & 0xFFFFFFFF
+
+        if self.__debug:
+            print("Sending frame", frame_id, "of size", len(data),
+                  "in", fragment_count, "datagrams")
+        for index in range(fragment_count):
+            offset = index * fragment_size
+            header = self.__datagram_header.pack(
+                frame_id, len(data), offset, index, fragment_count)
+            try:
+                sent = self.__connection.sendmsg(
+                    [header, data[offset:offset + fragment_size]])
+            except ConnectionRefusedError:
+                # Nobody is listening (yet), the frame is lost like any other datagram
+                if self.__debug:
+                    print("Peer refused frame", frame_id)
+                return
+            self.__pace_send(sent)
+            if self.__sleep_between_packets > 0 and index + 1 < fragment_count:
+                time.sleep(self.__sleep_between_packets)
+
+    def __receive_datagram_frame(self):
+        """[summary] Receive datagrams until a frame is complete (SOCK_DGRAM). Frames
+            are never delivered out of order: datagrams of frames older than the last
+            delivered one are ignored, and frames still incomplete when a newer frame
+            completes are dropped, so a lost datagram costs one frame instead of
+            stalling the stream.
+
+        Returns:
+            [bytearray]: [Complete message, None if the datagram timeout passed]
+        """
+        header_size = self.__datagram_header.size
+        buffer = bytearray(self.MAX_DATAGRAM_SIZE)
+        view = memoryview(buffer)
+        deadline = time.monotonic() + self.__datagram_timeout
+        while True:
+            if self.__datagram_timeout > 0:
+                remaining = deadline - time.monotonic()
+                if remaining <= 0 or not select.select([self.__connection], [], [], remaining)[0]:
+                    if self.__debug:
+                        print("No complete frame within",
+                              self.__datagram_timeout, "seconds")
+                    return None
+            try:
+                valread = self.__connection.recv_into(buffer)
+            except ConnectionRefusedError:
+                # Reports a datagram we sent before the peer was listening
+                continue
+            if valread < header_size:
+                continue
+
+            frame_id, frame_size, offset, index, count = self.__datagram_header.unpack_from(
+                buffer)
+            fragment = view[header_size:valread]
+            # Skip frames that are not newer than the last one delivered
+            if self.__last_datagram_frame is not None and \
+                    not self.__frame_is_newer(frame_id, self.__last_datagram_frame):
+                continue
+            # The frame buffer is allocated from the first datagram, so its size is capped
+            if index >= count or offset + len(fragment) > frame_size or \
+                    frame_size > self.__max_message_size:
+                if self.__debug:
+                    print("Ignoring malformed datagram of frame", frame_id)
+                continue
+
+            frame = self.__datagram_frame(frame_id, frame_size, count)
+            if frame is None or frame[1][index]:
+                continue
+            frame[0][offset:offset + len(fragment)] = fragment
+            frame[1][index] = 1
+            frame[2] -= 1
+            frame[3] += len(fragment)
+            if frame[2] > 0:
+                continue
+            if frame[3] != frame_size:
+                # The fragments overlap or leave gaps, so the frame cannot be trusted
+                if self.__debug:
+                    print("Dropping frame", frame_id,
+                          ", its fragments do not add up to its size")
+                del self.__datagram_frames[frame_id]
+                continue
+
+            # Frame complete: frames that were skipped since the last one are dropped
+            if self.__last_datagram_frame is not None:
+                self.__dropped_frame_count += (frame_id -
+                                               self.__last_datagram_frame - 1) & 0xFFFFFFFF
+            self.__last_datagram_frame = frame_id
+            self.__datagram_frames = {pending_id: pending for pending_id, pending in self.__datagram_frames.items()
+                                      if self.__frame_is_newer(pending_id, frame_id)}
+            if self.__debug:
+                print("Received frame", frame_id, "of size", frame_size)
+            return frame[0]
+
+    def __datagram_frame(self, frame_id: int, frame_size: int, fragment_count: int):
+        """[summary] Find the reassembly state of a frame, or start reassembling it
+            (dropping the oldest frame if too many are in progress).
+
+        Returns:
+            [list]: [[data, received fragments, fragments left, bytes received], None if the datagram
+            is to be ignored]
+        """
+        frame = self.__datagram_frames.get(frame_id)
+        if frame is not None:
+            # Datagrams of one frame must agree on its layout
+            if len(frame[0]) != frame_size or len(frame[1]) != fragment_count:
+                return None
+            return frame
+
+        if len(self.__datagram_frames) >= self.__datagram_reassembly_slots:
+            oldest_id = max(self.__datagram_frames,
+                            key=lambda pending_id: (frame_id - pending_id) & 0xFFFFFFFF)
+            # All slots are busy with newer frames
+            if not self.__frame_is_newer(frame_id, oldest_id):
+                return None
+            del self.__datagram_frames[oldest_id]
+
+        frame = [bytearray(frame_size), bytearray(fragment_count), fragment_count, 0]
+        self.__datagram_frames[frame_id] = frame
+        return frame
+
+    def set_shared_memory(self, slot_count: int, slot_size: int):
+        """[summary] A setter function to send Mats through shared memory (same host
+            only, binary framing required). A ring of slot_count slots of slot_size
+            bytes is created in /dev/shm and send_mat copies each Mat into the next
+            slot, so only a small notification goes through the socket. The receiving
+            receive_mat/readMat maps the ring and returns the Mat without copying it.
+            Mats that do not fit in a slot, or that find the next slot still in use by
+            the receiver, are sent through the socket as usual.
+
+        Args:
+            slot_count (int): [Number of slots (at least 2, 0 disables shared memory)]
+            slot_size (int): [Size of each slot in bytes]
+        """
+        if self.__shm_outbound is not None:
+            self.__shm_outbound.close()
+            self.__unlink_shared_memory(self.__shm_outbound)
+            self.__shm_outbound = None
+        self.__shm_attach_sent = False
+        if slot_count == 0:
+            return
+        if slot_count < 2:
+            raise ValueError("Shared memory needs at least 2 slots")
+
+        name = "/ezpysocket_{}_{}".format(os.getpid(),
+                                          next(self.__shm_ring_counter))
+        slot_size = -(-slot_size // 64) * 64
+        ring_size = EzSharedMemoryRing(
+            name, None, slot_count, slot_size).slot_offset(slot_count)
+        shm_fd = os.open("/dev/shm" + name, os.O_CREAT |
+                         os.O_EXCL | os.O_RDWR, 0o600)
+        try:
+            os.ftruncate(shm_fd, ring_size)
+            memory = mmap.mmap(shm_fd, ring_size)
+        finally:
+            os.close(shm_fd)
+
+        # New memory is zero filled, so all slots start out SHM_SLOT_FREE
+        self.__shm_ring_header.pack_into(
+            memory, 0, self.SHM_MAGIC, slot_count, slot_size)
+        self.__shm_outbound = EzSharedMemoryRing(
+            name, memory, slot_count, slot_size)
+
+    def __unlink_shared_memory(self, ring):
+        """[summary] Remove the name of a ring created by this end (the receiving
+            side unlinks it as soon as it is mapped, so this may find nothing).
+        """
+        if ring is None:
+            return
+        try:
+            os.unlink("/dev/shm" + ring.name)
+        except OSError:
+            pass
+
+    def __send_shared_mat(self, img, cv_type: int, step: int) -> bool:
+        """[summary] Send a Mat through the shared memory ring, if one is set up.
+
+        Returns:
+            [bool]: [False if the Mat has to be sent through the socket instead]
+        """
+        ring = self.__shm_outbound
+        if ring is None:
+            return False
+        if not self.__binary_framing:
+            raise Exception("Shared memory transport requires binary framing")
+
+        slot = ring.next_slot
+        if img.nbytes > ring.slot_size or ring.get_state(slot) != self.SHM_SLOT_FREE:
+            return False
+
+        if not self.__shm_attach_sent:
+            self.__send_message(self.MSG_SHM_ATTACH, "Shared memory attach",
+                                self.__shm_attach_header.pack(ring.slot_count, ring.slot_size), ring.name)
+            self.__shm_attach_sent = True
+
+        offset = ring.slot_offset(slot)
+        ring.memory[offset:offset + img.nbytes] = memoryview(img).cast('B')
+        ring.set_state(slot, self.SHM_SLOT_READY)
+        ring.next_slot = (slot + 1) % ring.slot_count
+
+        self.__send_message(self.MSG_SHM_MAT, "Shared memory Mat",
+                            self.__shm_mat_header.pack(slot, img.shape[0], img.shape[1], cv_type, step))
+        return True
+
+    def __attach_shared_memory(self, payload: memoryview):
+        """[summary] Map the shared memory ring announced by the peer.
+
+        Args:
+            payload (memoryview): [MSG_SHM_ATTACH payload]
+        """
+        name = str(payload[self.__shm_attach_header.size:], 'utf-8')
+        self.__release_shared_slot()
+        if self.__shm_inbound is not None:
+            self.__shm_inbound.close()
+
+        shm_fd = os.open("/dev/shm" + name, os.O_RDWR)
+        try:
+            memory = mmap.mmap(shm_fd, os.fstat(shm_fd).st_size)
+        finally:
+            os.close(shm_fd)
+        # Nothing else needs the name, unlinking now leaves nothing behind if a process dies
+        os.unlink("/dev/shm" + name)
+
+        magic, slot_count, slot_size = self.__shm_ring_header.unpack_from(
+            memory)
+        ring = EzSharedMemoryRing(name, memory, slot_count, slot_size)
+        if magic != self.SHM_MAGIC or ring.slot_offset(slot_count) > len(memory):
+            ring.close()
+            raise Exception("Shared memory ring of peer is invalid")
+        self.__shm_inbound = ring
+        if self.__debug:
+            print("Attached shared memory", name, "slots :",
+                  slot_count, "slot size :", slot_size)
+
+    def __receive_shared_mat(self, payload: memoryview):
+        """[summary] Return the Mat announced by a MSG_SHM_MAT notification. The array
+            is a view of the shared slot, which is handed back to the sender on the
+            next receive_mat.
+
+        Returns:
+            [numpy.ndarray]: [Array of shape (rows, cols) or (rows, cols, channels)]
+        """
+        ring = self.__shm_inbound
+        slot, rows, cols, cv_type, step = self.__shm_mat_header.unpack_from(
+            payload)
+        dtype = None if ring is None else self.__mat_dtype(
+            rows, cols, cv_type, step, ring.slot_size)
+        if dtype is None or slot >= ring.slot_count \
+                or ring.get_state(slot) != self.SHM_SLOT_READY:
+            raise Exception(
+                "Shared memory Mat check in received message failed")
+        self.__shm_held_slot = slot
+
+        channels = (cv_type >> 3) + 1
+        shape = (rows, cols) if channels == 1 else (rows, cols, channels)
+        strides = (step, channels * dtype.itemsize, dtype.itemsize)[:len(shape)]
+        return np.ndarray(shape, dtype=dtype, buffer=ring.memory,
+                          offset=ring.slot_offset(slot), strides=strides)
+
+    def __release_shared_slot(self):
+        """[summary] Hand the slot of the last shared memory Mat back to the sender
+        """
+        if self.__shm_held_slot >= 0 and self.__shm_inbound is not None:
+            self.__shm_inbound.set_state(
+                self.__shm_held_slot, self.SHM_SLOT_FREE)
+        self.__shm_held_slot = -1
+
     def loop_func_decorator(self, func):
         def new_func(self, data, show_ips):
             self.__loop_iteration_count += 1
@@ -215,7 +929,9 @@ class EzPySocket:
             data (dict, optional): [The dictionary that needs to be passed to the function]. Defaults to {}.
             loop_count (int, optional): [Looping behaviour
             if -1, loops until stop_loop is called on server side,
-            if 0, loops until stop_loop is called from client side (Status string is sent)
+            if 0, loops until stop_loop is called from client side (by default a status
+            string is read after every iteration, which keeps server functions that send
+            first and older peers working; see set_loop_stop_message to drop it)
             else, loops for as many iterations as specified]. Defaults to 0.
             show_ips (bool, optional): [Show iterations per second]. Defaults to False.
         """
@@ -226,7 +942,13 @@ class EzPySocket:
             while self.__loop_flag:
                 decorated_func(self, data, show_ips)
 
-        if loop_count == 0:
+        if loop_count == 0 and self.__loop_stop_message:
+            # Server is up until the client stops its loop. The client only sends a
+            # stop message when it is done, so iterations carry nothing but user data.
+            decorated_func(self, data, show_ips)
+            while not self.__receive_loop_stop():
+                decorated_func(self, data, show_ips)
+        elif loop_count == 0:
             # Server is up until Client has gotten its request
             status = "Active"
             while status != "Stop":
@@ -245,14 +967,20 @@ class EzPySocket:
             func ([function]): [The function that has to be executed in the loop]
             data (dict, optional): [The dictionary that needs to be passed to the function]. Defaults to {}.
             loop_count (int, optional): [Looping behaviour
-            if 0, loops until stop_loop is called from client side
+            if 0, loops until stop_loop is called from client side (by default a status
+            string is sent after every iteration, see set_loop_stop_message)
             else, loops for as many iterations as specified]. Defaults to 0.
             show_ips (bool, optional): [Show iterations per second]. Defaults to True.
         """
         self.__loop_flag = True
         self.__loop_start_time = time.time()
         decorated_func = self.loop_func_decorator(func)
-        if loop_count == 0:
+        if loop_count == 0 and self.__loop_stop_message:
+            # Client is up until stop_loop is called, then tells the server to stop
+            while self.__loop_flag:
+                decorated_func(self, data, show_ips)
+            self.__send_loop_stop()
+        elif loop_count == 0:
             # Client is up until Server has gotten its request
             status = "Active"
             while status != "Stop":
@@ -314,60 +1042,343 @@ class EzPySocket:
                 message = self.__tokens[0] + str(message) + self.__tokens[1]
         return message
 
-    def __extract_tokens(self, message):
-        """[summary] Extracting tokens from the received messages to get the actual message.
-            This also serves as a check on the validity of the message. Currently throws
-            an error if invalid message is received.
+    def __check_tokens(self, message: memoryview) -> memoryview:
+        """[summary] Check the tokens around a received message in place. This serves as
+            a check on the validity of the message. Currently throws an error if invalid
+            message is received.
 
         Args:
-            message ([str/bytes]): [Token included received message]
+            message ([memoryview]): [Token included received message]
 
         Raises:
             Exception: [Starting token check in received message failed]
             Exception: [Ending token check in received message failed]
 
         Returns:
-            [str/bytes]: [Message with tokens extracted]
+            [memoryview]: [View of the message without the tokens]
         """
         if self.__tokens != ["", ""]:
-            if type(message) is bytes:
-                start_token = bytes(self.__tokens[0], encoding='utf8')
-                end_token = bytes(self.__tokens[1], encoding='utf8')
-            else:
-                start_token = self.__tokens[0]
-                end_token = self.__tokens[1]
+            start_token = bytes(self.__tokens[0], encoding='utf8')
+            end_token = bytes(self.__tokens[1], encoding='utf8')
 
-            # Remove start token
-            index = message.find(start_token)
-            if index != 0:
+            if message[:len(start_token)] != start_token:
                 print(
                     "Starting token was not found at the beginning of message received!",
                     " Please check if the right kind of data is being sent/received or that",
                     " the same tokens are set on server and client ends...")
                 raise Exception(
                     "Starting token check in received message failed")
-            else:
-                message = message[index+len(start_token):]
-
-            # Remove end token
-            end_token_in_message = False
-            while not end_token_in_message:
-                index = message.rfind(end_token)
-                if index != (len(message) - len(end_token)):
-                    print(
-                        "Ending token was not found at the end of message received!",
-                        " Please check if the right kind of data is being sent/received or that",
-                        " the same tokens are set on server and client ends...",
-                        "\nAdditionally, try increasing set_sleep_between_packets value.",
-                        "Current sleep_between_packets value: " + str(self.get_sleep_between_packets()))
-                    raise Exception(
-                        "Ending token check in received message failed")
-                else:
-                    message = message[:-len(end_token)]
-                    end_token_in_message = True
+
+            if len(message) < len(start_token) + len(end_token) or \
+                    message[len(message) - len(end_token):] != end_token:
+                print(
+                    "Ending token was not found at the end of message received!",
+                    " Please check if the right kind of data is being sent/received or that",
+                    " the same tokens are set on server and client ends...")
+                raise Exception(
+                    "Ending token check in received message failed")
+
+            message = message[len(start_token):len(message) - len(end_token)]
 
         return message
 
+    def __frame_header_bytes(self, msg_type: int, payload_size: int, flags: int = 0, codec: int = 0) -> bytes:
+        """[summary] Build the header that precedes every message. With binary framing
+            this is a fixed width frame header, else the 16 digit size string sent by send_int.
+
+        Args:
+            msg_type (int): [Type of message that follows]
+            payload_size (int): [Size of the (token included) payload in bytes]
+            flags (int, optional): [Frame flags (binary framing only)]. Defaults to 0.
+            codec (int, optional): [Image codec (binary framing only)]. Defaults to 0.
+
+        Returns:
+            [bytes]: [Header to be sent]
+        """
+        if not self.__binary_framing:
+            return bytes(self.__insert_tokens(format(payload_size, '016d')), 'utf-8')
+        if payload_size > 0xFFFFFFFF:
+            raise ValueError("Message of " + str(payload_size) + " bytes does not fit in a binary frame of at most " +
+                             str(0xFFFFFFFF) + " bytes!")
+        return self.__frame_header.pack(payload_size, msg_type, flags, codec)
+
+    def __send_buffers(self, buffers: list):
+        """[summary] Send all buffers with as few sendmsg calls as possible (scatter-gather),
+            retrying on partial sends. If sleep_between_packets is set, the data is
+            sent in packets of packet_size with the delay in between, and with
+            set_rate_limit the sends are paced by a token bucket.
+
+        Args:
+            buffers (list): [bytes-like objects to be sent in order]
+        """
+        buffers = [memoryview(b).cast('B') for b in buffers
+                   if memoryview(b).nbytes > 0]
+        if self.__socket_type == socket.SOCK_DGRAM:
+            self.__send_datagrams(buffers)
+            return
+        seqpacket = self.__socket_type == socket.SOCK_SEQPACKET
+        if self.__sleep_between_packets > 0:
+            data = memoryview(b"".join(buffers))
+            packet_size = min(self.__packet_size, self.__seqpacket_record_size) \
+                if seqpacket else self.__packet_size
+            if self.__rate_limit > 0:
+                packet_size = min(packet_size, self.__rate_burst)
+            for packet_start_index in range(0, len(data), packet_size):
+                packet = data[packet_start_index:packet_start_index+packet_size]
+                self.__connection.sendall(packet)
+                self.__pace_send(len(packet))
+                time.sleep(self.__sleep_between_packets)
+            return
+
+        # Each sendmsg call is one record (SOCK_SEQPACKET) and at most one burst (set_rate_limit)
+        limit = self.__seqpacket_record_size if seqpacket else 0
+        if self.__rate_limit > 0 and (limit == 0 or limit > self.__rate_burst):
+            limit = self.__rate_burst
+        while buffers:
+            batch = buffers
+            if limit > 0:
+                batch, total = [], 0
+                for buffer in buffers:
+                    if total + len(buffer) >= limit:
+                        batch.append(buffer[:limit - total])
+                        break
+                    batch.append(buffer)
+                    total += len(buffer)
+            try:
+                sent = self.__connection.sendmsg(batch)
+            except InterruptedError:
+                continue
+            self.__pace_send(sent)
+            # Advance past the bytes that were sent
+            while sent > 0:
+                if sent >= len(buffers[0]):
+                    sent -= len(buffers[0])
+                    buffers.pop(0)
+                else:
+                    buffers[0] = buffers[0][sent:]
+                    sent = 0
+
+    def __receive_header(self, expected_type: int) -> int:
+        """[summary] Read the header that precedes every message. The flags and image
+            codec of a binary frame header are kept for receive_image.
+
+        Args:
+            expected_type (int): [Type of message the caller wants to read]
+
+        Returns:
+            [int]: [Size of the (token included) payload in bytes]
+        """
+        if not self.__binary_framing:
+            self.__received_flags = 0
+            self.__received_codec = self.CODEC_JPEG
+            return self.receive_int()
+
+        received = self.__receive_buffer(self.__frame_header.size)  # blocking
+        payload_size, msg_type, self.__received_flags, self.__received_codec = self.__frame_header.unpack(
+            received)
+        if self.__debug:
+            print("Received frame header, type :", msg_type,
+                  "payload size :", payload_size)
+        payload_size = self.__inflate_message(
+            payload_size, self.__received_flags)
+
+        if msg_type != expected_type:
+            print("Received message of type", msg_type, "while expecting type", expected_type, "!",
+                  " Please check if the right kind of data is being sent/received or that",
+                  " binary framing is set on both server and client ends...")
+        return payload_size
+
+    def __receive_exact_into(self, view):
+        """[summary] Fill the given buffer completely, retrying on short reads.
+
+        Args:
+            view ([memoryview]): [Writable buffer to be filled]
+
+        Raises:
+            ConnectionError: [Connection closed by peer while reading]
+        """
+        received = 0
+        if len(self.__inflated) > 0:
+            # Rest of a decompressed message (see __inflate_message)
+            received = min(len(view), len(self.__inflated))
+            view[:received] = self.__inflated[:received]
+            self.__inflated = self.__inflated[received:]
+        if self.__socket_type in (socket.SOCK_SEQPACKET, socket.SOCK_DGRAM):
+            # A partially read record would lose its remainder, so whole records
+            # (or reassembled frames) are received and the bytes that were not
+            # asked for are kept
+            while received < len(view):
+                if len(self.__staged_record) == 0:
+                    self.__staged_record = memoryview(self.__receive_staged())
+                count = min(len(view) - received, len(self.__staged_record))
+                view[received:received + count] = self.__staged_record[:count]
+                self.__staged_record = self.__staged_record[count:]
+                received += count
+            return
+
+        while received < len(view):
+            try:
+                valread = self.__connection.recv_into(view[received:])
+            except InterruptedError:
+                continue
+            if valread == 0:
+                raise ConnectionError(
+                    "Connection closed by peer while reading")
+            received += valread
+
+    def __receive_staged(self):
+        """[summary] Receive the next unit that is staged for reading: a record with
+            SOCK_SEQPACKET, a complete message with SOCK_DGRAM.
+
+        Raises:
+            TimeoutError: [No complete frame within the datagram timeout]
+        """
+        if self.__socket_type == socket.SOCK_SEQPACKET:
+            return self.__receive_record()
+        frame = self.__receive_datagram_frame()
+        if frame is None:
+            raise TimeoutError("No complete frame within the datagram timeout")
+        return frame
+
+    def __receive_record(self) -> bytes:
+        """[summary] Receive one SOCK_SEQPACKET record.
+
+        Raises:
+            ConnectionError: [Connection closed by peer, or a record larger than
+            the record size was received]
+
+        Returns:
+            [bytes]: [Received record]
+        """
+        while True:
+            try:
+                record, _, msg_flags, _ = self.__connection.recvmsg(
+                    self.__seqpacket_record_size)
+                break
+            except InterruptedError:
+                continue
+        if len(record) == 0:
+            raise ConnectionError("Connection closed by peer while reading")
+        if msg_flags & socket.MSG_TRUNC:
+            raise ConnectionError("Received a record larger than " + str(self.__seqpacket_record_size) +
+                                  " bytes, is the peer using SOCK_SEQPACKET records of a different size?")
+        return record
+
+    def __peek_exact(self, size: int) -> bytes:
+        """[summary] Wait until size bytes are available and return them without
+            removing them from the connection.
+
+        Args:
+            size (int): [Number of bytes to peek at]
+
+        Raises:
+            ConnectionError: [Connection closed by peer while reading]
+
+        Returns:
+            [bytes]: [Next size bytes of the stream]
+        """
+        if self.__socket_type == socket.SOCK_DGRAM:
+            # Messages are never split across frames, so the next frame holds the whole message
+            if len(self.__staged_record) == 0:
+                self.__staged_record = memoryview(self.__receive_staged())
+            if len(self.__staged_record) < size:
+                raise ConnectionError(
+                    "Received frame is smaller than the message header")
+            return bytes(self.__staged_record[:size])
+
+        if self.__socket_type == socket.SOCK_SEQPACKET:
+            # Peeking only sees the first record, so stage as many records as needed
+            while len(self.__staged_record) < size:
+                self.__staged_record = memoryview(
+                    bytes(self.__staged_record) + self.__receive_record())
+            return bytes(self.__staged_record[:size])
+
+        while True:
+            try:
+                peeked = self.__connection.recv(
+                    size, socket.MSG_PEEK | socket.MSG_WAITALL)
+            except InterruptedError:
+                continue
+            if len(peeked) == size:
+                return peeked
+            if len(peeked) == 0:
+                raise ConnectionError(
+                    "Connection closed by peer while reading")
+
+    def __send_loop_stop(self):
+        """[summary] Tell the peer's server loop that the client loop has stopped.
+            With binary framing this is a MSG_CONTROL message, else a header carrying
+            the loop stop marker in place of the 16 digit size.
+        """
+        if self.__binary_framing:
+            self.__send_message(self.MSG_CONTROL, "Control",
+                                bytes([self.CONTROL_LOOP_STOP]))
+            return
+        self.__send_buffers([bytes(self.__tokens[0], 'utf-8'), self.__loop_stop_marker,
+                             bytes(self.__tokens[1], 'utf-8')])
+
+    def __receive_loop_stop(self) -> bool:
+        """[summary] Wait for the next message and consume it if it is the client's
+            loop stop message. Any other message is left untouched for the next read.
+
+        Returns:
+            [bool]: [True if the client has stopped its loop]
+        """
+        if self.__binary_framing:
+            header = self.__peek_exact(self.__frame_header.size)
+            if self.__frame_header.unpack(header)[1] != self.MSG_CONTROL:
+                return False
+            payload = self.__receive_payload(self.MSG_CONTROL)
+            return bytes(payload) == bytes([self.CONTROL_LOOP_STOP])
+
+        start_token = bytes(self.__tokens[0], 'utf-8')
+        end_token = bytes(self.__tokens[1], 'utf-8')
+        header = self.__peek_exact(
+            len(start_token) + len(self.__loop_stop_marker))
+        if header[len(start_token):] != self.__loop_stop_marker:
+            return False
+        self.__receive_buffer(len(header) + len(end_token))
+        return True
+
+    def __receive_buffer(self, size: int, reuse: bool = True) -> memoryview:
+        """[summary] Read exactly size bytes from the connection. By default the bytes
+            are read into a receive buffer that is reused across messages (and only
+            grows), so the returned view is only valid until the next read.
+
+        Args:
+            size (int): [Number of bytes to read]
+            reuse (bool, optional): [Read into the reused receive buffer, else into
+            a newly allocated buffer owned by the caller]. Defaults to True.
+
+        Returns:
+            [memoryview]: [View of the received bytes]
+        """
+        self.__check_message_size(size)
+        if not reuse:
+            buffer = bytearray(size)
+        else:
+            if len(self.__recv_buffer) < size:
+                # New buffer instead of resize, views of the old one may still be alive
+                self.__recv_buffer = bytearray(
+                    max(size, 2 * len(self.__recv_buffer)))
+            buffer = self.__recv_buffer
+        view = memoryview(buffer)[:size]
+        self.__receive_exact_into(view)
+        return view
+
+    def __receive_payload(self, msg_type: int, reuse: bool = True) -> memoryview:
+        """[summary] Read a complete message and check its tokens in place.
+
+        Args:
+            msg_type (int): [Type of message expected]
+            reuse (bool, optional): [Read into the reused receive buffer]. Defaults to True.
+
+        Returns:
+            [memoryview]: [View of the payload without the tokens]
+        """
+        payload_size = self.__receive_header(msg_type)
+        return self.__check_tokens(self.__receive_buffer(payload_size, reuse))
+
     # Incoming
 
     def receive_bool(self) -> bool:
@@ -397,18 +1408,38 @@ class EzPySocket:
         Returns:
             [bytes]: [String that was received.]
         """
-        string_length = self.receive_int()
-        received = self.__connection.recv(string_length)  # blocking
+        return self.__receive_text(self.MSG_STRING)
+
+    def __receive_text(self, msg_type: int) -> str:
+        """[summary] Receive a text message of the given type
+
+        Args:
+            msg_type (int): [Type of message expected]
+
+        Returns:
+            [str]: [String that was received.]
+        """
+        received = str(self.__receive_payload(msg_type), 'utf-8')  # blocking
         if self.__debug:
-            print("receive_string: string_length received : ",
-                  string_length)
             print('Received {!r} as message'.format(received))
-
-        # remove the "b'" and the "'" at the end
-        received = str(received)[2:-1]
-        received = self.__extract_tokens(received)
         return received
 
+    def __receive_number(self, message_length: int) -> str:
+        """[summary] Receive the fixed width text of an int/float (without binary framing)
+
+        Args:
+            message_length (int): [Size of message to be read in bytes]
+
+        Returns:
+            [str]: [Received text]
+        """
+        received = self.__receive_buffer(
+            message_length + len(self.__tokens[0]) + len(self.__tokens[1]))  # blocking
+        if self.__debug:
+            print("Receiving Buffer data of size (in bytes): ", len(received))
+            print('Received {!r} as message'.format(received.tobytes()))
+        return str(self.__check_tokens(received), 'utf-8')
+
     def receive_int(self, message_length: int = 16) -> int:
         """[summary] Receive an int value
 
@@ -419,15 +1450,14 @@ class EzPySocket:
         Returns:
             [int]: [The integer value that was received]
         """
-        received = self.__connection.recv(
-            message_length + len(self.__tokens[0]) + len(self.__tokens[1]))  # blocking
-        if self.__debug:
-            print("Receiving Buffer data of size (in bytes): ",
-                  message_length + len(self.__tokens[0]) + len(self.__tokens[1]))
-            print('Received {!r} as message'.format(received))
+        if self.__binary_framing:
+            received = struct.unpack_from(
+                "<i", self.__receive_payload(self.MSG_INT))[0]  # blocking
+            if self.__debug:
+                print("Converted int :", received)
+            return received
 
-        received = int(self.__extract_tokens(received.decode("utf-8")))
-        return received
+        return int(self.__receive_number(message_length))
 
     def receive_float(self, message_length: int = 16) -> float:
         """[summary] Receive an float value
@@ -439,76 +1469,273 @@ class EzPySocket:
         Returns:
             [float]: [The float value that was received]
         """
-        received = self.__connection.recv(
-            message_length + len(self.__tokens[0]) + len(self.__tokens[1]))  # blocking
-        if self.__debug:
-            print("Receiving Buffer data of size (in bytes): ",
-                  message_length + len(self.__tokens[0]) + len(self.__tokens[1]))
-            print('Received {!r} as message'.format(received))
+        if self.__binary_framing:
+            received = struct.unpack_from(
+                "<f", self.__receive_payload(self.MSG_FLOAT))[0]  # blocking
+            if self.__debug:
+                print("Converted float :", received)
+            return received
 
-        received = float(self.__extract_tokens(received.decode("utf-8")))
-        return received
+        return float(self.__receive_number(message_length))
+
+    def __receive_list(self, msg_type: int, expected_dtype: int):
+        """[summary] Receive a binary list
+
+        Args:
+            msg_type (int): [Type of message expected]
+            expected_dtype (int): [Data type of the elements expected]
+
+        Raises:
+            Exception: [List header check in received message failed]
+
+        Returns:
+            [numpy.ndarray]: [1-D array of the received elements]
+        """
+        # Not the reused buffer, the returned array is a view of it
+        received = self.__receive_payload(msg_type, reuse=False)
+        dtype, count = self.__list_header.unpack_from(received)
+        if self.__debug:
+            print("Received list header, data type :", dtype,
+                  "element count :", count)
+
+        if dtype != expected_dtype or \
+                len(received) != self.__list_header.size + count * self.__dtypes[dtype].itemsize:
+            print("Received list of data type", dtype, "while expecting data type", expected_dtype, "!",
+                  " Please check if the right kind of data is being sent/received or that",
+                  " binary lists are set on both server and client ends...")
+            raise Exception("List header check in received message failed")
+        return np.frombuffer(received, dtype=self.__dtypes[dtype], count=count,
+                             offset=self.__list_header.size)
 
     def receive_int_list(self):
         """[summary] Receive a list of int
+            (numpy array of int32 when binary lists are enabled)
 
         Returns:
             [list]: [List of ints]
         """
-        received = self.receive_string()
+        if self.__binary_lists:
+            return self.__receive_list(self.MSG_INT_LIST, self.DTYPE_INT32)
+        received = self.__receive_text(self.MSG_INT_LIST)
         return eval(received)
 
     def receive_float_list(self):
         """[summary] Receive a list of floats
+            (numpy array of float32 when binary lists are enabled)
 
         Returns:
             [list]: [List of floats]
         """
-        received = self.receive_string()
+        if self.__binary_lists:
+            return self.__receive_list(self.MSG_FLOAT_LIST, self.DTYPE_FLOAT32)
+        received = self.__receive_text(self.MSG_FLOAT_LIST)
         return eval(received)
 
     def receive_image(self,
-                      color_format: int = cv2.IMREAD_COLOR,
+                      color_format: int = None,
                       dtype: str = 'uint8'):
-        """[summary] Receive an image
+        """[summary] Receive an image, decoded with the codec named in its header
 
         Args:
             color_format (int, optional): [The color format to be used].
-            Defaults to cv2.IMREAD_COLOR.
+            Defaults to None (cv2.IMREAD_UNCHANGED if the sender keeps channels,
+            else cv2.IMREAD_COLOR).
 
             dtype (str, optional): [Datatype to be used when reading buffer].
             Defaults to 'uint8'.
 
         Returns:
-            [cv2.Mat]: [cv2 image that was received]
+            [cv2.Mat]: [cv2 image that was received, None if no complete frame
+            arrived within the datagram timeout (SOCK_DGRAM)]
         """
-        message_length = self.receive_int()
+        if self.__socket_type == socket.SOCK_DGRAM and len(self.__staged_record) == 0:
+            # A frame that does not arrive in time is skipped
+            frame = self.__receive_datagram_frame()
+            if frame is None:
+                return None
+            self.__staged_record = memoryview(frame)
+        received = self.__receive_payload(self.MSG_IMAGE)
         if self.__debug:
-            print("receive_image: message_length received : ",
-                  message_length)
-
-        data_img_buffer = bytes()
-        packet_start_index = 0
-        packet_size_curr = self.__packet_size
-        while packet_start_index < message_length:
-            if ((packet_start_index + self.__packet_size) > message_length):
-                packet_size_curr = message_length - packet_start_index
-
-            # blocking
-            data_img_buffer += self.__connection.recv(packet_size_curr)
-            if self.__debug:
-                print("Receiving packet no. ",
-                      packet_start_index / self.__packet_size)
-                print("Current packet size : ", packet_size_curr)
-                print("Current size of data accumulated : ", len(data_img_buffer))
-            packet_start_index += packet_size_curr
-            time.sleep(self.__sleep_between_packets)
-
-        data_img_buffer = self.__extract_tokens(data_img_buffer)
-        data_img = np.frombuffer(data_img_buffer, dtype=dtype)
+            print("receive_image: message_length received : ", len(received))
+        if self.__received_flags & self.FLAG_DELTA:
+            print("Received a delta image, which only a Cpp receiver can patch together!"
+                  " Please turn off setDeltaImages on the sending end...")
+            raise Exception("Delta images are not supported in Python")
+
+        if self.__received_codec == self.CODEC_RAW:
+            # The payload is in the reused receive buffer, so the pixels are copied out
+            return self.__mat_from_payload(received).copy()
+        if color_format is None:
+            color_format = cv2.IMREAD_UNCHANGED if self.__received_flags & self.FLAG_KEEP_CHANNELS \
+                else cv2.IMREAD_COLOR
+        if self.__received_flags & self.FLAG_TILED:
+            return self.__decode_tiles(received, color_format)
+        data_img = np.frombuffer(received, dtype=dtype)
         decimg = cv2.imdecode(data_img, color_format)
         return decimg
 
+    def receive_images(self, color_format: int = None):
+        """[summary] Receive a batch of images sent with send_images / sendImages. The
+            images are decoded in parallel on the tile pool (see set_image_tiles).
+
+        Args:
+            color_format (int, optional): [The color format to be used].
+            Defaults to None (cv2.IMREAD_UNCHANGED if the sender keeps channels,
+            else cv2.IMREAD_COLOR).
+
+        Returns:
+            [list]: [cv2 images in the order they were sent (None for empty images)]
+        """
+        received = self.__receive_payload(self.MSG_IMAGE_BATCH)
+        if len(received) < self.__batch_header.size:
+            raise Exception("Image batch check in received message failed")
+        count, = self.__batch_header.unpack_from(received)
+        offset = self.__batch_header.size * (count + 1)
+        if len(received) < offset:
+            raise Exception("Image batch check in received message failed")
+        images = []
+        for size, in self.__batch_header.iter_unpack(received[self.__batch_header.size:offset]):
+            images.append(received[offset:offset + size])
+            offset += size
+        if offset != len(received):
+            print("Received image batch table does not match the size of the message received!")
+            raise Exception("Image batch check in received message failed")
+        if self.__debug:
+            print("receive_images: batch of", count, "images, size :", len(received))
+
+        if color_format is None:
+            color_format = cv2.IMREAD_UNCHANGED if self.__received_flags & self.FLAG_KEEP_CHANNELS \
+                else cv2.IMREAD_COLOR
+        raw = self.__received_codec == self.CODEC_RAW
+
+        def decode(image):
+            if len(image) == 0:
+                return None
+            if raw:
+                # The payload is in the reused receive buffer, so the pixels are copied out
+                return self.__mat_from_payload(image).copy()
+            return cv2.imdecode(np.frombuffer(image, dtype=np.uint8), color_format)
+        return list(self.__get_tile_pool().map(decode, images))
+
+    def receive_mat(self):
+        """[summary] Receive a raw Mat sent without image encoding. If the peer sent it
+            through shared memory (set_shared_memory / setSharedMemory), the returned
+            array is a view of the shared slot and only valid until the next
+            receive_mat (copy it to keep it longer).
+
+        Returns:
+            [numpy.ndarray]: [Array of shape (rows, cols) or (rows, cols, channels)]
+        """
+        self.__release_shared_slot()
+        if self.__binary_framing:
+            # The peer may send the Mat through its shared memory ring instead
+            payload_size, msg_type, flags, _ = self.__frame_header.unpack(
+                self.__receive_buffer(self.__frame_header.size))
+            while msg_type == self.MSG_SHM_ATTACH:
+                self.__attach_shared_memory(self.__check_tokens(
+                    self.__receive_buffer(payload_size)))
+                payload_size, msg_type, flags, _ = self.__frame_header.unpack(
+                    self.__receive_buffer(self.__frame_header.size))
+            if msg_type == self.MSG_SHM_MAT:
+                return self.__receive_shared_mat(self.__check_tokens(
+                    self.__receive_buffer(payload_size)))
+            if msg_type != self.MSG_MAT:
+                print("Received message of type", msg_type, "while expecting type", self.MSG_MAT, "!")
+            payload_size = self.__inflate_message(payload_size, flags)
+            # Not the reused buffer, the returned array is a view of it
+            received = self.__check_tokens(
+                self.__receive_buffer(payload_size, reuse=False))
+        else:
+            # Not the reused buffer, the returned array is a view of it
+            received = self.__receive_payload(self.MSG_MAT, reuse=False)
+        return self.__mat_from_payload(received)
+
+    def __mat_dtype(self, rows: int, cols: int, cv_type: int, step: int, max_size: int):
+        """[summary] Check a received Mat header before anything is built from it. An
+            empty Mat must not carry pixel data; otherwise every row has to fit in
+            step bytes and the pixel data in max_size bytes.
+
+        Returns:
+            [numpy.dtype]: [Element type of the Mat, None if the header is invalid]
+        """
+        depth = cv_type & 7
+        channels = (cv_type >> 3) + 1
+        dtypes = [d for d, code in self.__cv_depths.items() if code == depth]
+        if not dtypes or channels > 512:
+            return None
+        if rows == 0 or cols == 0:
+            return dtypes[0] if rows == 0 or step == 0 else None
+        if step < cols * channels * dtypes[0].itemsize or rows * step > max_size:
+            return None
+        return dtypes[0]
+
+    def __mat_from_payload(self, received: memoryview):
+        """[summary] Build the array of a raw Mat payload (Mat header and pixel data).
+
+        Args:
+            received (memoryview): [Payload, the array is a view of it unless rows are padded]
+
+        Returns:
+            [numpy.ndarray]: [Array of shape (rows, cols) or (rows, cols, channels)]
+        """
+        rows, cols, cv_type, step = self.__mat_header.unpack_from(received)
+        if self.__debug:
+            print("receive_mat rows :", rows, "cols :", cols,
+                  "type :", cv_type, "step :", step)
+        dtype = self.__mat_dtype(rows, cols, cv_type, step,
+                                 len(received) - self.__mat_header.size)
+        if dtype is None or len(received) != self.__mat_header.size + rows * step:
+            print("Received Mat header does not match the size of the message received!")
+            raise Exception("Mat header check in received message failed")
+
+        channels = (cv_type >> 3) + 1
+        row_size = cols * channels * dtype.itemsize
+
+        data = np.frombuffer(received, dtype=np.uint8, count=rows * step,
+                             offset=self.__mat_header.size)
+        # Drop row padding if any, then view as pixels
+        data = data.reshape(rows, step)[:, :row_size]
+        data = np.ascontiguousarray(data).view(dtype)
+        if channels == 1:
+            return data.reshape(rows, cols)
+        return data.reshape(rows, cols, channels)
+
+    def receive_tensor(self):
+        """[summary] Receive an N-dimensional tensor sent with sendTensor/send_tensor
+
+        Raises:
+            Exception: [Tensor header check in received message failed]
+
+        Returns:
+            [numpy.ndarray]: [Array with the received data type and shape]
+        """
+        # Not the reused buffer, the returned array is a view of it
+        received = self.__receive_payload(self.MSG_TENSOR, reuse=False)
+        dtype, ndim, _ = self.__tensor_header.unpack_from(received)
+        offset = self.__tensor_header.size
+        shape = struct.unpack_from("<" + "I" * ndim, received, offset)
+        offset += 4 * ndim
+        if self.__debug:
+            print("Received tensor header, data type :", dtype, "shape :", shape)
+        # The shape comes from the peer, so the element count is checked against the
+        # maximum message size at each step (np.prod would silently overflow)
+        itemsize = self.__dtypes[dtype].itemsize if dtype in self.__dtypes else 1
+        count = 1
+        for dim in shape:
+            count *= dim
+            if count > self.__max_message_size // itemsize:
+                print("Received tensor shape has more elements than fit in the maximum message size",
+                      self.__max_message_size, "! Use set_max_message_size to allow larger messages.")
+                raise Exception("Tensor header check in received message failed")
+
+        if dtype not in self.__dtypes or \
+                len(received) != offset + count * self.__dtypes[dtype].itemsize:
+            print("Received tensor of data type", dtype, "does not match the size of the message received!",
+                  " Please check if the right kind of data is being sent/received...")
+            raise Exception("Tensor header check in received message failed")
+        return np.frombuffer(received, dtype=self.__dtypes[dtype], count=count,
+                             offset=offset).reshape(shape)
+
     # Outgoing
 
     def __send_byte_data(self, datatype: str, data):
@@ -518,10 +1745,11 @@ class EzPySocket:
             datatype (str): [Type of data that's being sent]
             data ([type]): [Data to be sent]
         """
-        data = bytes(data, 'utf-8')
+        if type(data) is not bytes:
+            data = bytes(data, 'utf-8')
         if self.__debug:
             print("Sending " + datatype + " ...", data)
-        self.__connection.sendall(data)
+        self.__send_buffers([data])
 
     def send_bool(self, data: bool):
         """[summary] Send a boolean value
@@ -540,9 +1768,33 @@ class EzPySocket:
         Args:
             data (str): [String to be sent]
         """
-        data = self.__insert_tokens(data)
-        self.send_int(len(data))
-        self.__send_byte_data("String", data)
+        self.__send_message(self.MSG_STRING, "String", data)
+
+    def __send_message(self, msg_type: int, datatype: str, *payload, flags: int = 0, codec: int = 0):
+        """[summary] Send a complete message: header, start token, payload and end token
+            are gathered into a single scatter-gather write without concatenating them.
+
+        Args:
+            msg_type (int): [Type of message being sent]
+            datatype (str): [Type of data that's being sent (for debug)]
+            payload ([str/bytes-like]): [Buffers that make up the message, in order]
+            flags (int, optional): [Frame flags (binary framing only)]. Defaults to 0.
+            codec (int, optional): [Image codec (binary framing only)]. Defaults to 0.
+        """
+        payload = [bytes(part, 'utf-8') if type(part) is str else part
+                   for part in payload]
+        start_token = bytes(self.__tokens[0], encoding='utf8')
+        end_token = bytes(self.__tokens[1], encoding='utf8')
+        payload_size = len(start_token) + len(end_token) + \
+            sum(memoryview(part).nbytes for part in payload)
+
+        compression_flag, body, payload_size = self.__compress_message(
+            msg_type, codec, [start_token] + payload + [end_token], payload_size)
+
+        if self.__debug:
+            print("Sending " + datatype + " of size :", payload_size)
+        self.__send_buffers([self.__frame_header_bytes(msg_type, payload_size, flags | compression_flag, codec)]
+                            + body)
 
     def send_int(self, data: int):
         """[summary] Send an int value
@@ -550,6 +1802,9 @@ class EzPySocket:
         Args:
             data (int): [Integer to be sent]
         """
+        if self.__binary_framing:
+            self.__send_message(self.MSG_INT, "Int", struct.pack("<i", data))
+            return
         self.__send_byte_data(
             "Int", self.__insert_tokens(format(data, '016d')))
 
@@ -559,6 +1814,10 @@ class EzPySocket:
         Args:
             data (float): [Float to be sent]
         """
+        if self.__binary_framing:
+            self.__send_message(
+                self.MSG_FLOAT, "Float", struct.pack("<f", data))
+            return
         self.__send_byte_data(
             "Float", self.__insert_tokens(format(data, '016f')))
 
@@ -568,9 +1827,10 @@ class EzPySocket:
         Args:
             data (list): [List of values(integers) to be sent]
         """
-        data = self.__insert_tokens(str(data))
-        self.send_int(len(data))  # send size of list
-        self.__send_byte_data("Int List", data)
+        if self.__binary_lists:
+            self.__send_list(self.MSG_INT_LIST, self.DTYPE_INT32, data)
+            return
+        self.__send_message(self.MSG_INT_LIST, "Int List", str(data))
 
     def send_float_list(self, data: list):
         """[summary] Send a list of values
@@ -578,30 +1838,370 @@ class EzPySocket:
         Args:
             data (list): [List of values(floats) to be sent]
         """
-        data = self.__insert_tokens(str(data))
-        self.send_int(len(data))  # send size of list
-        self.__send_byte_data("Float List", data)
+        if self.__binary_lists:
+            self.__send_list(self.MSG_FLOAT_LIST, self.DTYPE_FLOAT32, data)
+            return
+        self.__send_message(self.MSG_FLOAT_LIST, "Float List", str(data))
+
+    def __send_list(self, msg_type: int, dtype: int, data):
+        """[summary] Send a list as a binary list header followed by the raw elements
+
+        Args:
+            msg_type (int): [Type of message being sent]
+            dtype (int): [Data type of the elements]
+            data ([list/numpy.ndarray]): [Values to be sent]
+        """
+        data = np.ascontiguousarray(data, dtype=self.__dtypes[dtype]).ravel()
+        if self.__debug:
+            print("Sending list, data type :", dtype,
+                  "element count :", data.size)
+        self.__send_message(msg_type, "List",
+                            self.__list_header.pack(dtype, data.size), data)
 
     def send_image(self, img):
-        """[summary] Send an image
+        """[summary] Send an image, encoded with the codec set by set_image_codec
+            (JPEG by default)
 
         Args:
             img ([cv2.Mat]): [OpenCV Image]
         """
-        data = self.__insert_tokens(cv2.imencode('.jpg', img)[1].tobytes())
-        self.send_int(len(data))
+        if not self.__binary_framing and (self.__image_codec == self.CODEC_RAW or self.__keep_channels):
+            raise Exception(
+                "Raw images and keep_channels need binary framing! Use set_binary_framing on both ends.")
+        flags = self.FLAG_KEEP_CHANNELS if self.__keep_channels else 0
+        if self.__image_codec == self.CODEC_RAW:
+            img, cv_type, step = self.__mat_layout(img)
+            self.__send_message(self.MSG_IMAGE, "Image", self.__mat_header.pack(img.shape[0], img.shape[1], cv_type, step),
+                                img, flags=flags, codec=self.CODEC_RAW)
+            return
+
+        params = [] if self.__image_quality < 0 else \
+            [self.__codec_quality_params[self.__image_codec], self.__image_quality]
+        if self.__image_tiles > 1 and img.size > 0:
+            if not self.__binary_framing:
+                raise Exception(
+                    "Tiled images need binary framing! Use set_binary_framing on both ends.")
+            self.__send_message(self.MSG_IMAGE, "Image", *self.__encode_tiles(img, params),
+                                flags=flags | self.FLAG_TILED, codec=self.__image_codec)
+            return
+        self.__send_message(self.MSG_IMAGE, "Image",
+                            cv2.imencode(self.__codec_extensions[self.__image_codec], img, params)[1],
+                            flags=flags, codec=self.__image_codec)
+
+    def send_images(self, imgs: list):
+        """[summary] Send a batch of images as one message, received whole by
+            receive_images / readImages. The images are encoded in parallel on the tile
+            pool with the codec set by set_image_codec and sent after a table of their
+            sizes. Tiles do not apply to batches.
 
-        packet_start_index = 0
-        packet_size_curr = self.__packet_size
-        while packet_start_index < len(data):
-            if ((packet_start_index + self.__packet_size) > len(data)):
-                packet_size_curr = len(data) - packet_start_index
-            if self.__debug:
-                print("Sending packet no. ",
-                      packet_start_index / self.__packet_size)
-                print("Sending packet of size : ", len(
-                    data[packet_start_index:packet_start_index+packet_size_curr]))
-            self.__connection.sendall(
-                data[packet_start_index:packet_start_index+packet_size_curr])
-            packet_start_index += packet_size_curr
-            time.sleep(self.__sleep_between_packets)
+        Args:
+            imgs (list): [OpenCV Images (None or empty images are received as empty)]
+        """
+        if not self.__binary_framing and (self.__image_codec == self.CODEC_RAW or self.__keep_channels):
+            raise Exception(
+                "Raw images and keep_channels need binary framing! Use set_binary_framing on both ends.")
+        flags = self.FLAG_KEEP_CHANNELS if self.__keep_channels else 0
+        params = [] if self.__image_quality < 0 else \
+            [self.__codec_quality_params[self.__image_codec], self.__image_quality]
+
+        def encode(img):
+            if img is None or img.size == 0:
+                return []
+            if self.__image_codec == self.CODEC_RAW:
+                img, cv_type, step = self.__mat_layout(img)
+                return [self.__mat_header.pack(img.shape[0], img.shape[1], cv_type, step), img]
+            return [cv2.imencode(self.__codec_extensions[self.__image_codec], img, params)[1]]
+        encoded = list(self.__get_tile_pool().map(encode, imgs))
+
+        table = bytearray(self.__batch_header.pack(len(encoded)))
+        for parts in encoded:
+            table += self.__batch_header.pack(sum(memoryview(part).nbytes for part in parts))
+        self.__send_message(self.MSG_IMAGE_BATCH, "Image batch", table,
+                            *[part for parts in encoded for part in parts],
+                            flags=flags, codec=self.__image_codec)
+
+    def set_image_codec(self, codec: int, quality: int = -1, keep_channels: bool = False):
+        """[summary] A setter function for how send_image encodes images. The codec
+            travels in the frame header, so the receiver decodes each image with the
+            right codec. JPEG, PNG and WebP are detected by the decoder, so they also
+            work with text framing. CODEC_RAW and keep_channels need binary framing.
+
+        Args:
+            codec (int): [CODEC_JPEG, CODEC_PNG, CODEC_WEBP or CODEC_RAW (no encoding, like send_mat)]
+            quality (int, optional): [JPEG quality (0-100), PNG compression level (0-9)
+            or WebP quality (1-100, above 100 is lossless), ignored by CODEC_RAW].
+            Defaults to -1 (OpenCV default).
+            keep_channels (bool, optional): [If True, the receiver decodes images with
+            their own channels and depth, e.g. grayscale stays single channel instead
+            of becoming BGR]. Defaults to False.
+        """
+        if codec not in (self.CODEC_JPEG, self.CODEC_PNG, self.CODEC_WEBP, self.CODEC_RAW):
+            print("Unknown image codec", codec)
+            return
+        self.__image_codec = codec
+        self.__image_quality = quality
+        self.__keep_channels = keep_channels
+
+    def get_image_codec(self):
+        """[summary] A getter function for the codec used by send_image
+        """
+        return self.__image_codec
+
+    def set_image_tiles(self, tile_count: int, thread_count: int = 0):
+        """[summary] A setter function to split images sent by send_image into horizontal
+            stripes (binary framing required). The stripes are encoded and decoded in
+            parallel on a thread pool, so codec time scales with the number of cores.
+            Tiled images are always accepted by receive_image, whatever this setting.
+            Ignored by CODEC_RAW.
+
+        Args:
+            tile_count (int): [Number of stripes (1 sends whole images)]
+            thread_count (int, optional): [Threads encoding/decoding the stripes].
+            Defaults to 0 (one per core).
+        """
+        thread_count = thread_count if thread_count > 0 else (os.cpu_count() or 1)
+        self.__image_tiles = max(tile_count, 1)
+        if thread_count != self.__tile_threads and self.__tile_pool is not None:
+            self.__tile_pool.shutdown()
+            self.__tile_pool = None
+        self.__tile_threads = thread_count
+
+    def get_image_tiles(self):
+        """[summary] A getter function for the number of stripes send_image splits images into
+        """
+        return self.__image_tiles
+
+    def __get_tile_pool(self) -> ThreadPoolExecutor:
+        """[summary] Pool encoding and decoding the stripes of tiled images, started on first use
+        """
+        if self.__tile_pool is None:
+            self.__tile_pool = ThreadPoolExecutor(
+                self.__tile_threads if self.__tile_threads > 0 else (os.cpu_count() or 1))
+        return self.__tile_pool
+
+    def __encode_tiles(self, img, params: list) -> list:
+        """[summary] Encode an image as horizontal stripes in parallel (see set_image_tiles).
+            cv2.imencode releases the GIL, so the stripes are encoded on several cores.
+
+        Args:
+            img ([cv2.Mat]): [OpenCV Image]
+            params (list): [Codec parameters]
+
+        Returns:
+            [list]: [Tiled image header and tile table, followed by the encoded stripes]
+        """
+        rows = img.shape[0]
+        # Stripe heights are a multiple of 16 rows, so stripe edges fall on JPEG block boundaries
+        rows_per_tile = ((rows + self.__image_tiles - 1) // self.__image_tiles + 15) // 16 * 16
+        first_rows = range(0, rows, rows_per_tile)
+        extension = self.__codec_extensions[self.__image_codec]
+        stripes = list(self.__get_tile_pool().map(
+            lambda first_row: cv2.imencode(extension, img[first_row:first_row + rows_per_tile], params)[1],
+            first_rows))
+
+        table = bytearray(self.__tiled_header.pack(rows, img.shape[1], len(stripes)))
+        for first_row, stripe in zip(first_rows, stripes):
+            table += self.__tile_entry.pack(min(rows_per_tile, rows - first_row), stripe.nbytes)
+        return [table] + stripes
+
+    def __decode_tiles(self, received: memoryview, color_format: int):
+        """[summary] Decode a tiled image payload (FLAG_TILED). The stripes are decoded
+            in parallel and copied into their rows of the returned image.
+
+        Args:
+            received (memoryview): [Received payload]
+            color_format (int): [cv2.imdecode flag]
+
+        Returns:
+            [cv2.Mat]: [Decoded image]
+        """
+        if len(received) < self.__tiled_header.size:
+            raise Exception("Tiled image check in received message failed")
+        rows, cols, tile_count = self.__tiled_header.unpack_from(received)
+        offset = self.__tiled_header.size + tile_count * self.__tile_entry.size
+        if len(received) < offset:
+            raise Exception("Tiled image check in received message failed")
+
+        # Rows and encoded bytes of each stripe
+        tiles = []
+        first_row = 0
+        for tile in range(tile_count):
+            tile_rows, tile_size = self.__tile_entry.unpack_from(
+                received, self.__tiled_header.size + tile * self.__tile_entry.size)
+            tiles.append((first_row, tile_rows, received[offset:offset + tile_size]))
+            first_row += tile_rows
+            offset += tile_size
+        if first_row != rows or offset != len(received):
+            print("Received tile table does not match the size of the message received!")
+            raise Exception("Tiled image check in received message failed")
+
+        stripes = list(self.__get_tile_pool().map(
+            lambda tile: cv2.imdecode(np.frombuffer(tile[2], dtype=np.uint8), color_format), tiles))
+        if len(stripes) == 0:
+            return None
+        if any(stripe is None or stripe.shape[0] != tile[1] or stripe.shape[1] != cols
+               or stripe.shape[2:] != stripes[0].shape[2:] or stripe.dtype != stripes[0].dtype
+               for stripe, tile in zip(stripes, tiles)):
+            raise Exception("Decoding image tile failed")
+        frame = np.empty((rows, cols) + stripes[0].shape[2:], dtype=stripes[0].dtype)
+        for stripe, tile in zip(stripes, tiles):
+            frame[tile[0]:tile[0] + tile[1]] = stripe
+        return frame
+
+    def set_compression(self, method: int, level: int = 0, threshold: int = 1024):
+        """[summary] A setter function to compress outgoing payloads (binary framing only).
+            Strings, lists, tensors and raw Mats/images of at least threshold bytes are
+            compressed, the frame flags tell the receiver to decompress them. Both ends
+            need the method available (lz4 / zstandard package, EZCPPSOCKET_WITH_LZ4 /
+            EZCPPSOCKET_WITH_ZSTD in Cpp) to read compressed messages.
+
+        Args:
+            method (int): [COMPRESSION_NONE, COMPRESSION_LZ4 (fast) or COMPRESSION_ZSTD (better ratio)]
+            level (int, optional): [zstd compression level, ignored by LZ4]. Defaults to 0 (zstd default).
+            threshold (int, optional): [Smallest payload in bytes that gets compressed]. Defaults to 1024.
+        """
+        if method == self.COMPRESSION_LZ4 and lz4 is None:
+            print("LZ4 compression needs the lz4 package (pip install lz4)")
+            return
+        if method == self.COMPRESSION_ZSTD and zstandard is None:
+            print("zstd compression needs the zstandard package (pip install zstandard)")
+            return
+        if method not in (self.COMPRESSION_NONE, self.COMPRESSION_LZ4, self.COMPRESSION_ZSTD):
+            print("Unknown compression method", method)
+            return
+        self.__compression = method
+        self.__compression_level = level
+        self.__compression_threshold = threshold
+
+    def get_compression(self):
+        """[summary] A getter function for the compression of outgoing payloads
+        """
+        return self.__compression
+
+    def __compress_message(self, msg_type: int, codec: int, body: list, payload_size: int):
+        """[summary] Compress the tokens and payload of a message if compression is set,
+            the type carries compressible data and the payload is at least the
+            compression threshold. Encoded images are never compressed again. The
+            message is left alone if compressing does not make it smaller.
+
+        Args:
+            msg_type (int): [Type of message being sent]
+            codec (int): [Image codec of the message]
+            body (list): [Buffers of the tokens and payload]
+            payload_size (int): [Size of the tokens and payload]
+
+        Returns:
+            [tuple]: [(frame flag of the compression used or 0, body, payload size)]
+        """
+        compressible = msg_type in (self.MSG_STRING, self.MSG_INT_LIST, self.MSG_FLOAT_LIST,
+                                    self.MSG_MAT, self.MSG_TENSOR) or \
+            (msg_type in (self.MSG_IMAGE, self.MSG_IMAGE_BATCH) and codec == self.CODEC_RAW)
+        if self.__compression == self.COMPRESSION_NONE or not self.__binary_framing or \
+                not compressible or payload_size < self.__compression_threshold:
+            return 0, body, payload_size
+
+        data = b"".join(memoryview(part).cast('B') for part in body)
+        if self.__compression == self.COMPRESSION_LZ4:
+            flag, compressed = self.FLAG_LZ4, lz4.block.compress(
+                data, store_size=False)
+        else:
+            flag = self.FLAG_ZSTD
+            compressed = zstandard.ZstdCompressor(
+                level=self.__compression_level or 3).compress(data)
+        if self.__compression_header.size + len(compressed) >= payload_size:
+            return 0, body, payload_size
+
+        if self.__debug:
+            print("Compressed payload of size", payload_size,
+                  "to", len(compressed))
+        return flag, [self.__compression_header.pack(payload_size), compressed], \
+            self.__compression_header.size + len(compressed)
+
+    def __inflate_message(self, message_size: int, flags: int) -> int:
+        """[summary] Decompress the message whose frame header was just read, if its
+            flags say it is compressed. The decompressed message is read before the
+            connection by the following reads, so callers read it like any other message.
+
+        Args:
+            message_size (int): [Size of the message on the wire]
+            flags (int): [Frame flags of the message]
+
+        Returns:
+            [int]: [Size of the (decompressed) message]
+        """
+        if not flags & (self.FLAG_LZ4 | self.FLAG_ZSTD):
+            return message_size
+
+        message = self.__receive_buffer(message_size)
+        if message_size < self.__compression_header.size:
+            raise Exception("Compressed message check in received message failed")
+        size, = self.__compression_header.unpack_from(message)
+        # The decompressors allocate the declared size up front
+        self.__check_message_size(size)
+        compressed = message[self.__compression_header.size:]
+        if flags & self.FLAG_LZ4:
+            if lz4 is None:
+                raise Exception(
+                    "Received an LZ4 compressed message, install the lz4 package to read it")
+            data = lz4.block.decompress(compressed, uncompressed_size=size)
+        else:
+            if zstandard is None:
+                raise Exception(
+                    "Received a zstd compressed message, install the zstandard package to read it")
+            data = zstandard.ZstdDecompressor().decompress(compressed, max_output_size=size)
+        if len(data) != size:
+            raise Exception("Decompressing received message failed")
+
+        if self.__debug:
+            print("Decompressed payload of size", len(compressed), "to", size)
+        self.__inflated = memoryview(data)
+        return size
+
+    def __mat_layout(self, img):
+        """[summary] Describe an array as a Mat (made contiguous first)
+
+        Returns:
+            [tuple]: [(contiguous array, OpenCV type, step in bytes)]
+        """
+        img = np.ascontiguousarray(img)
+        cols = img.shape[1]
+        channels = img.shape[2] if img.ndim == 3 else 1
+        cv_type = self.__cv_depths[img.dtype] + ((channels - 1) << 3)
+        return img, cv_type, cols * channels * img.dtype.itemsize
+
+    def send_mat(self, img):
+        """[summary] Send a raw Mat (numpy array) without image encoding
+
+        Args:
+            img ([numpy.ndarray]): [Array of shape (rows, cols) or (rows, cols, channels)]
+        """
+        img, cv_type, step = self.__mat_layout(img)
+        rows, cols = img.shape[:2]
+        if self.__send_shared_mat(img, cv_type, step):
+            return
+
+        self.__send_message(self.MSG_MAT, "Mat",
+                            self.__mat_header.pack(rows, cols, cv_type, step), img)
+
+    def send_tensor(self, data):
+        """[summary] Send an N-dimensional tensor along with its data type and shape
+
+        Args:
+            data ([numpy.ndarray]): [Array of uint8, int8, uint16, int16, int32,
+            int64, float32 or float64]
+        """
+        data = np.asarray(data)
+        dtype = [code for code, d in self.__dtypes.items()
+                 if d == data.dtype.newbyteorder('<')][0]
+        # astype (unlike ascontiguousarray) keeps 0-d arrays as scalars
+        data = data.astype(self.__dtypes[dtype], order='C', copy=False)
+        if data.ndim > 255:
+            raise ValueError("Tensors can have at most 255 dimensions")
+        if any(dim > 0xFFFFFFFF for dim in data.shape):
+            raise ValueError("Tensor dimensions must be smaller than 2^32")
+        if self.__debug:
+            print("Sending tensor, data type :", dtype, "shape :", data.shape)
+
+        header = self.__tensor_header.pack(dtype, data.ndim, 0) + \
+            struct.pack("<" + "I" * data.ndim, *data.shape)
+        self.__send_message(self.MSG_TENSOR, "Tensor", header, data)
@@ -21,4 +21,5 @@ setuptools.setup(
     ],
     python_requires='>=3.6',
     install_requires=['numpy'],
+    extras_require={'lz4': ['lz4'], 'zstd': ['zstandard']},
 )   
\ No newline at end of file